@@ -0,0 +1,503 @@
+/**
+ * @date Fri 16 Oct 2026 21:07:12 CEST
+ *
+ * @brief Implementation of the binary format for libsvm models
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#include <bob.learn.libsvm/binary.h>
+#include <bob.learn.libsvm/kernel.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+#include <boost/format.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+/**
+ * Signature at the start of every file in the binary format
+ */
+static const char MAGIC[8] = {'\x89', 'B', 'O', 'B', 'S', 'V', 'M', '\n'};
+
+/**
+ * Written as is in the header, to detect files of another byte order
+ */
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+/**
+ * Boundary at which the header and every block of the file start
+ */
+static const size_t ALIGNMENT = 64;
+
+/**
+ * Blocks of the file, in the order they are written
+ */
+enum section_t {
+  LABEL, ///< class labels, nr_class int32_t
+  NR_SV, ///< support vectors per class, nr_class int32_t
+  RHO, ///< one double per decision function
+  PROB_A, ///< one double per decision function
+  PROB_B, ///< one double per decision function
+  PROB_DENSITY_MARKS, ///< 10 doubles, for one-class machines
+  SV_COEF, ///< nr_class-1 rows of l doubles
+  SV_ROWS, ///< dense support vectors, l rows of stride doubles
+  SV_NORMS, ///< squared norms of the dense support vectors, l doubles
+  SV_NODES, ///< libsvm nodes, if support vectors are not dense
+  SV_START, ///< first node of every support vector, l uint64_t
+  INPUT_SUB, ///< at least input_size doubles
+  INPUT_DIV, ///< at least input_size doubles
+  SECTIONS
+};
+
+/**
+ * Position and size, in bytes, of a block. Sizes of 0 denote blocks absent
+ * from the model.
+ */
+struct section {
+  uint64_t offset;
+  uint64_t size;
+};
+
+/**
+ * Header of the binary format, at the start of the file
+ */
+struct header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t node_size; ///< sizeof(svm_node) on the writing platform
+  uint32_t dense; ///< 1 if support vectors are stored as dense rows
+  int32_t svm_type;
+  int32_t kernel_type;
+  int32_t degree;
+  int32_t nr_class;
+  double gamma;
+  double coef0;
+  uint64_t l; ///< number of support vectors
+  uint64_t input_size;
+  uint64_t stride;
+  uint64_t nodes; ///< number of libsvm nodes, including terminators
+  section sections[SECTIONS];
+};
+
+static inline uint64_t align(uint64_t offset) {
+  return ALIGNMENT * ((offset + ALIGNMENT - 1) / ALIGNMENT);
+}
+
+/**
+ * Number of decision functions, one per pair of classes
+ */
+static inline size_t pairs(size_t nr_class) {
+  return nr_class * (nr_class - 1) / 2;
+}
+
+#if LIBSVM_VERSION >= 330
+/**
+ * Number of density marks of one-class machines, fixed by libsvm
+ */
+static const size_t NR_MARKS = 10;
+#endif
+
+void bob::learn::libsvm::svm_write_binary(const std::string& filename,
+    const svm_model* model, size_t input_size, size_t stride,
+    const blitz::Array<double,1>& input_sub,
+    const blitz::Array<double,1>& input_div) {
+
+  if ((size_t)input_sub.extent(0) < input_size ||
+      (size_t)input_div.extent(0) < input_size) {
+    boost::format s("input scaling of binary model file '%s' should have at least %d values");
+    s % filename % input_size;
+    throw std::runtime_error(s.str());
+  }
+
+  const size_t l = model->l;
+  const size_t nr_class = model->nr_class;
+  const size_t n_dec = pairs(nr_class);
+
+  size_t nodes = 0;
+  bool one_based = true; ///< if dense rows have a column for every value
+  for (size_t k=0; k<l; ++k) {
+    const svm_node* end = model->SV[k];
+    while (end->index != -1) {
+      if (end->index < 1) one_based = false;
+      ++end;
+    }
+    nodes += end - model->SV[k] + 1;
+  }
+
+  header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = bob::learn::libsvm::BINARY_VERSION;
+  h.byte_order = BYTE_ORDER_MARK;
+  h.node_size = sizeof(svm_node);
+  //same choice as Machine's default representation
+  h.dense = model->param.kernel_type != PRECOMPUTED && one_based &&
+    l * stride <= 2 * nodes;
+  h.svm_type = model->param.svm_type;
+  h.kernel_type = model->param.kernel_type;
+  h.degree = model->param.degree;
+  h.nr_class = nr_class;
+  h.gamma = model->param.gamma;
+  h.coef0 = model->param.coef0;
+  h.l = l;
+  h.input_size = input_size;
+  h.stride = stride;
+  h.nodes = nodes;
+
+  //places blocks first, so the header can be written ahead of them
+  uint64_t offset = align(sizeof(header));
+  auto place = [&](section_t s, uint64_t size) {
+    if (!size) return;
+    h.sections[s].offset = offset;
+    h.sections[s].size = size;
+    offset = align(offset + size);
+  };
+  place(LABEL, model->label? nr_class * sizeof(int32_t) : 0);
+  place(NR_SV, model->nSV? nr_class * sizeof(int32_t) : 0);
+  place(RHO, n_dec * sizeof(double));
+  place(PROB_A, model->probA? n_dec * sizeof(double) : 0);
+  place(PROB_B, model->probB? n_dec * sizeof(double) : 0);
+#if LIBSVM_VERSION >= 330
+  place(PROB_DENSITY_MARKS,
+      model->prob_density_marks? NR_MARKS * sizeof(double) : 0);
+#endif
+  place(SV_COEF, (nr_class - 1) * l * sizeof(double));
+  if (h.dense) {
+    place(SV_ROWS, l * stride * sizeof(double));
+    place(SV_NORMS, l * sizeof(double));
+  }
+  else {
+    place(SV_NODES, nodes * sizeof(svm_node));
+    place(SV_START, l * sizeof(uint64_t));
+  }
+  place(INPUT_SUB, input_sub.extent(0) * sizeof(double));
+  place(INPUT_DIV, input_div.extent(0) * sizeof(double));
+
+  std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+  if (!out) {
+    boost::format s("cannot open binary model file '%s' for writing");
+    s % filename;
+    throw std::runtime_error(s.str());
+  }
+
+  out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+  //pads the file to the start of block "s", then writes "size" bytes, if
+  //the block is present
+  auto write = [&](section_t s, const void* data, size_t size) {
+    static const char zeros[ALIGNMENT] = {0};
+    if (!h.sections[s].size) return;
+    const uint64_t position = out.tellp();
+    out.write(zeros, h.sections[s].offset - position);
+    out.write(static_cast<const char*>(data), size);
+  };
+
+  if (h.sections[LABEL].size) {
+    const std::vector<int32_t> label(model->label, model->label + nr_class);
+    write(LABEL, label.data(), h.sections[LABEL].size);
+  }
+  if (h.sections[NR_SV].size) {
+    const std::vector<int32_t> nSV(model->nSV, model->nSV + nr_class);
+    write(NR_SV, nSV.data(), h.sections[NR_SV].size);
+  }
+  write(RHO, model->rho, h.sections[RHO].size);
+  write(PROB_A, model->probA, h.sections[PROB_A].size);
+  write(PROB_B, model->probB, h.sections[PROB_B].size);
+#if LIBSVM_VERSION >= 330
+  write(PROB_DENSITY_MARKS, model->prob_density_marks,
+      h.sections[PROB_DENSITY_MARKS].size);
+#endif
+  for (size_t k=0; k+1<nr_class; ++k) {
+    if (k == 0) write(SV_COEF, model->sv_coef[k], l * sizeof(double));
+    else out.write(reinterpret_cast<const char*>(model->sv_coef[k]),
+        l * sizeof(double));
+  }
+
+  if (h.dense) {
+    //rows are written one at a time, so that the model is never copied
+    std::vector<double> norms(l);
+    std::vector<double> row(stride);
+    for (size_t k=0; k<l; ++k) {
+      std::fill(row.begin(), row.end(), 0.);
+      for (const svm_node* it = model->SV[k]; it->index != -1; ++it) {
+        if (it->index < 1 || (size_t)it->index > input_size) {
+          boost::format s("support vector %d of the model written to '%s' has a value at dimension %d, out of the input size (%d)");
+          s % k % filename % it->index % input_size;
+          throw std::runtime_error(s.str());
+        }
+        row[it->index-1] = it->value;
+      }
+      //computed as Machine::setDense() does, for identical results
+      bob::learn::libsvm::dot(row.data(), row.data(), 0, 1, stride,
+          &norms[k]);
+      if (k == 0) write(SV_ROWS, row.data(), stride * sizeof(double));
+      else out.write(reinterpret_cast<const char*>(row.data()),
+          stride * sizeof(double));
+    }
+    write(SV_NORMS, norms.data(), h.sections[SV_NORMS].size);
+  }
+  else {
+    std::vector<uint64_t> start(l);
+    uint64_t position = 0;
+    for (size_t k=0; k<l; ++k) {
+      const svm_node* end = model->SV[k];
+      while (end->index != -1) ++end;
+      const size_t size = end - model->SV[k] + 1;
+      if (k == 0) write(SV_NODES, model->SV[k], size * sizeof(svm_node));
+      else out.write(reinterpret_cast<const char*>(model->SV[k]),
+          size * sizeof(svm_node));
+      start[k] = position;
+      position += size;
+    }
+    write(SV_START, start.data(), h.sections[SV_START].size);
+  }
+
+  const blitz::Array<double,1> sub = input_sub.copy();
+  const blitz::Array<double,1> div = input_div.copy();
+  write(INPUT_SUB, sub.data(), h.sections[INPUT_SUB].size);
+  write(INPUT_DIV, div.data(), h.sections[INPUT_DIV].size);
+
+  out.close();
+  if (!out) {
+    boost::format s("cannot write binary model file '%s'");
+    s % filename;
+    throw std::runtime_error(s.str());
+  }
+
+}
+
+bool bob::learn::libsvm::svm_is_binary(const std::string& filename) {
+  char magic[sizeof(MAGIC)];
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  return in.read(magic, sizeof(magic)) &&
+    !memcmp(magic, MAGIC, sizeof(MAGIC));
+}
+
+/**
+ * Frees a model returned by svm_map_binary(). Rows of coefficients and, if
+ * free_sv is 0, support vector nodes point into the file, which is unmapped
+ * once this deleter is destroyed.
+ */
+struct mapped_model_free {
+
+  boost::shared_ptr<boost::interprocess::mapped_region> region;
+
+  void operator()(svm_model* m) const {
+    if (m->free_sv && m->l > 0) free(m->SV[0]);
+    free(m->SV);
+    free(m->sv_coef);
+    free(m->rho);
+    free(m->probA);
+    free(m->probB);
+#if LIBSVM_VERSION >= 330
+    free(m->prob_density_marks);
+#endif
+    free(m->label);
+    free(m->nSV);
+    free(m);
+  }
+
+};
+
+/**
+ * Keeps the file mapped while arrays pointing into it are referenced
+ */
+struct mapped_array_free {
+  boost::shared_ptr<boost::interprocess::mapped_region> region;
+  void operator()(double*) const { }
+};
+
+bob::learn::libsvm::binary_model bob::learn::libsvm::svm_map_binary
+(const std::string& filename) {
+
+  boost::shared_ptr<boost::interprocess::mapped_region> region;
+  try {
+    boost::interprocess::file_mapping file(filename.c_str(),
+        boost::interprocess::read_only);
+    region = boost::make_shared<boost::interprocess::mapped_region>(file,
+        boost::interprocess::read_only);
+  }
+  catch (std::exception& e) {
+    boost::format s("cannot map binary model file '%s': %s");
+    s % filename % e.what();
+    throw std::runtime_error(s.str());
+  }
+
+  const char* data = static_cast<const char*>(region->get_address());
+  const size_t size = region->get_size();
+
+  auto fail = [&](const char* what) {
+    boost::format s("cannot load binary model file '%s': %s");
+    s % filename % what;
+    throw std::runtime_error(s.str());
+  };
+
+  if (size < sizeof(header) || memcmp(data, MAGIC, sizeof(MAGIC)))
+    fail("not a binary model file");
+
+  header h;
+  memcpy(&h, data, sizeof(h));
+  if (h.version != bob::learn::libsvm::BINARY_VERSION) {
+    boost::format s("cannot load binary model file '%s': written with version %d of the format, but only version %d is supported - convert the original model again");
+    s % filename % h.version % bob::learn::libsvm::BINARY_VERSION;
+    throw std::runtime_error(s.str());
+  }
+  if (h.byte_order != BYTE_ORDER_MARK || h.node_size != sizeof(svm_node))
+    fail("written on a platform with another byte order or layout of libsvm nodes");
+  if (h.svm_type < C_SVC || h.svm_type > NU_SVR ||
+      h.kernel_type < LINEAR || h.kernel_type > PRECOMPUTED)
+    fail("unknown machine or kernel type");
+  if (h.nr_class < 1 || h.l > (uint64_t)INT_MAX)
+    fail("invalid number of classes or support vectors");
+  if (h.input_size > size / sizeof(double) || h.stride > size / sizeof(double))
+    fail("invalid input size or stride of support vectors");
+
+  const size_t l = h.l;
+  const size_t nr_class = h.nr_class;
+  const size_t n_dec = pairs(nr_class);
+
+  //a product of header fields, refused if it cannot fit in the file, before
+  //it wraps around
+  auto product = [&](size_t a, size_t b) -> size_t {
+    if (a && b > size / a) fail("blocks are inconsistent with the header");
+    return a * b;
+  };
+  //a block, checked against the expected number of elements of type T, or
+  //null if it is absent and "optional" is set
+  auto block = [&](section_t s, size_t count, size_t element,
+      bool optional) -> const char* {
+    const section& b = h.sections[s];
+    if (!b.size && optional) return 0;
+    if (b.size != product(count, element) || b.offset % ALIGNMENT ||
+        b.offset > size || b.size > size - b.offset) {
+      fail("blocks are inconsistent with the header");
+    }
+    return data + b.offset;
+  };
+  auto doubles = [&](section_t s, size_t count, bool optional) {
+    return reinterpret_cast<const double*>(block(s, count, sizeof(double),
+          optional));
+  };
+  //copies an optional block into memory allocated with malloc(), as libsvm
+  //does
+  auto copy = [&](const char* b, size_t bytes) -> void* {
+    if (!b) return 0;
+    void* retval = malloc(std::max(bytes, (size_t)1));
+    if (!retval) throw std::bad_alloc();
+    memcpy(retval, b, bytes);
+    return retval;
+  };
+
+  svm_model* raw = static_cast<svm_model*>(calloc(1, sizeof(svm_model)));
+  if (!raw) throw std::bad_alloc();
+  mapped_model_free deleter = {region};
+  bob::learn::libsvm::binary_model retval;
+  retval.model.reset(raw, deleter);
+
+  raw->param.svm_type = h.svm_type;
+  raw->param.kernel_type = h.kernel_type;
+  raw->param.degree = h.degree;
+  raw->param.gamma = h.gamma;
+  raw->param.coef0 = h.coef0;
+  raw->nr_class = nr_class;
+  raw->l = l;
+  raw->free_sv = 0;
+
+  static_assert(sizeof(int) == sizeof(int32_t),
+      "class metadata is copied as is into libsvm's int arrays");
+  //classifiers need both to pair their support vectors and coefficients
+  const bool classifier = h.svm_type == C_SVC || h.svm_type == NU_SVC;
+  raw->label = static_cast<int*>(copy(block(LABEL, nr_class,
+          sizeof(int32_t), !classifier), nr_class * sizeof(int)));
+  raw->nSV = static_cast<int*>(copy(block(NR_SV, nr_class,
+          sizeof(int32_t), !classifier), nr_class * sizeof(int)));
+  if (raw->nSV) {
+    uint64_t total = 0;
+    for (size_t i=0; i<nr_class; ++i) {
+      if (raw->nSV[i] < 0) fail("negative number of support vectors");
+      total += raw->nSV[i];
+    }
+    if (total != l) fail("numbers of support vectors per class do not sum to their total");
+  }
+  raw->rho = static_cast<double*>(copy(block(RHO, n_dec, sizeof(double),
+          false), n_dec * sizeof(double)));
+  raw->probA = static_cast<double*>(copy(block(PROB_A, n_dec,
+          sizeof(double), true), n_dec * sizeof(double)));
+  raw->probB = static_cast<double*>(copy(block(PROB_B, n_dec,
+          sizeof(double), true), n_dec * sizeof(double)));
+#if LIBSVM_VERSION >= 330
+  raw->prob_density_marks = static_cast<double*>(copy(
+        block(PROB_DENSITY_MARKS, NR_MARKS, sizeof(double), true),
+        NR_MARKS * sizeof(double)));
+#endif
+
+  const double* sv_coef = doubles(SV_COEF, product(nr_class - 1, l), false);
+  raw->sv_coef = static_cast<double**>(calloc(std::max(nr_class - 1,
+          (size_t)1), sizeof(double*)));
+  raw->SV = static_cast<svm_node**>(calloc(std::max(l, (size_t)1),
+        sizeof(svm_node*)));
+  if (!raw->sv_coef || !raw->SV) throw std::bad_alloc();
+  for (size_t k=0; k+1<nr_class; ++k) {
+    raw->sv_coef[k] = const_cast<double*>(sv_coef + k * l);
+  }
+
+  retval.input_size = h.input_size;
+  retval.stride = h.stride;
+  retval.nodes = h.nodes;
+  if (h.stride < h.input_size) fail("invalid stride of support vectors");
+
+  const mapped_array_free array_deleter = {region};
+  if (h.dense) {
+    if (h.kernel_type == PRECOMPUTED)
+      fail("PRECOMPUTED kernels require support vectors stored as nodes");
+    const double* sv = doubles(SV_ROWS, product(l, h.stride), false);
+    const double* norms = doubles(SV_NORMS, l, false);
+    retval.sv.reset(const_cast<double*>(sv), array_deleter);
+    retval.sv_coef.reset(const_cast<double*>(sv_coef), array_deleter);
+    retval.sv_norms.reset(const_cast<double*>(norms), array_deleter);
+  }
+  else {
+    const svm_node* nodes = reinterpret_cast<const svm_node*>(block(SV_NODES,
+          h.nodes, sizeof(svm_node), false));
+    const uint64_t* start = reinterpret_cast<const uint64_t*>(block(SV_START,
+          l, sizeof(uint64_t), false));
+    //every support vector ends with a terminator, right before the next,
+    //and has increasing indices within the input, from 0 on, as
+    //svm_read_hdf5() requires
+    for (size_t k=0; k<l; ++k) {
+      const uint64_t end = (k+1 < l)? start[k+1] : h.nodes;
+      if (start[k] >= end || end > h.nodes || nodes[end-1].index != -1)
+        fail("invalid support vector nodes");
+      int previous = -1;
+      for (uint64_t j=start[k]; j+1<end; ++j) {
+        if (nodes[j].index <= previous ||
+            (uint64_t)nodes[j].index > h.input_size)
+          fail("invalid indices of support vector nodes");
+        previous = nodes[j].index;
+      }
+      raw->SV[k] = const_cast<svm_node*>(nodes + start[k]);
+    }
+  }
+
+  //scaling vectors may be longer than the input, see Machine
+  const size_t n_sub = h.sections[INPUT_SUB].size / sizeof(double);
+  const size_t n_div = h.sections[INPUT_DIV].size / sizeof(double);
+  if (n_sub < h.input_size || n_div < h.input_size)
+    fail("input scaling is shorter than the input");
+  const double* sub = doubles(INPUT_SUB, n_sub, false);
+  const double* div = doubles(INPUT_DIV, n_div, false);
+  retval.input_sub.resize(n_sub);
+  retval.input_div.resize(n_div);
+  std::copy(sub, sub + n_sub, retval.input_sub.data());
+  std::copy(div, div + n_div, retval.input_div.data());
+
+  return retval;
+
+}
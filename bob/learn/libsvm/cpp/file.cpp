@@ -8,67 +8,263 @@
  */
 
 #include <bob.learn.libsvm/file.h>
+#include <bob.learn.libsvm/parallel.h>
+#include <bob.learn.libsvm/number.h>
 #include <boost/format.hpp>
-#include <boost/algorithm/string.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 
-static bool is_colon(char i) { return i == ':'; }
+static inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+    c == '\f';
+}
 
-bob::learn::libsvm::File::File (const std::string& filename):
-  m_filename(filename),
-  m_file(m_filename.c_str()),
-  m_shape(0),
-  m_n_samples(0)
-{
-  if (!m_file) {
-    boost::format s("cannot open file '%s'");
-    s % filename;
+/**
+ * Finds the next line which is not blank, from "next" to "end". Sets "p" to
+ * its first non-blank character and "eol" to its end, which is "end" if the
+ * file does not end with a new line, and moves "next" to the line after it.
+ * Returns false if there is none.
+ */
+static bool next_line(const char*& next, const char* end, const char*& p,
+    const char*& eol) {
+  while (next < end) {
+    const char* start = next;
+    eol = static_cast<const char*>(memchr(start, '\n', end - start));
+    if (!eol) eol = end;
+    next = (eol < end) ? eol + 1 : end;
+    for (p = start; p < eol && is_space(*p); ++p);
+    if (p < eol) return true;
+  }
+  return false;
+}
+
+/**
+ * Returns the largest index of the sample on the line from "p" to "eol",
+ * skipping its label and values, which are only checked when read
+ */
+static size_t max_index(const char* p, const char* eol) {
+
+  size_t retval = 0;
+
+  while (p < eol && !is_space(*p)) ++p; //label
+
+  while (true) {
+    while (p < eol && is_space(*p)) ++p;
+    if (p == eol) break;
+    size_t index = 0;
+    while (p < eol && *p >= '0' && *p <= '9' && index <= INT_MAX)
+      index = 10 * index + (*p++ - '0');
+    if (index <= INT_MAX && index > retval) retval = index;
+    while (p < eol && !is_space(*p)) ++p; //value
+  }
+
+  return retval;
+
+}
+
+/**
+ * Parses the sample on the line from "p" to "eol", which ends with a new line
+ * character, calling "f(index, value)" for each of its values, with 1-based
+ * indexes. Values are read in the "C" locale, whatever the current one.
+ * Returns its label.
+ */
+template <typename F>
+static int parse_line(const char* p, const char* eol, size_t sample,
+    const std::string& filename, F& f) {
+
+  char* stop = const_cast<char*>(p);
+  long label = strtol(p, &stop, 10);
+  if (stop == p || !is_space(*stop) || label < INT_MIN || label > INT_MAX) {
+    boost::format s("cannot read the label of sample %d in file '%s'");
+    s % sample % filename;
     throw std::runtime_error(s.str());
   }
+  p = stop;
 
-  //scan the whole file, gets the shape and total size
-  while (m_file.good()) {
-    //gets the next non-empty line
-    std::string line;
-    while (!line.size()) {
-      if (!m_file.good()) break;
-      std::getline(m_file, line);
-      boost::trim(line);
+  while (true) {
+    while (p < eol && is_space(*p)) ++p;
+    if (p >= eol) break;
+    const char* start = p;
+    size_t index = 0;
+    while (*p >= '0' && *p <= '9' && index <= INT_MAX)
+      index = 10 * index + (*p++ - '0');
+    const bool has_value = p != start && *p == ':' && !is_space(p[1]) &&
+      index > 0 && index <= INT_MAX;
+    start = p + 1;
+    double value = has_value ?
+      bob::learn::libsvm::parseDouble(start, &stop) : 0.;
+    if (!has_value || stop == start || !is_space(*stop)) {
+      boost::format s("cannot read `index:value' pairs of sample %d in file '%s'");
+      s % sample % filename;
+      throw std::runtime_error(s.str());
     }
+    p = stop;
+    f(index, value);
+  }
+
+  return label;
+
+}
 
-    if (!m_file.good()) break;
+/**
+ * Parses the sample on the line from "p" to "eol", in a file ending at "end",
+ * as parse_line() does
+ */
+template <typename F>
+static int parse_sample(const char* p, const char* eol, const char* end,
+    size_t sample, const std::string& filename, F& f) {
+  if (eol < end) return parse_line(p, eol, sample, filename, f);
+  //the file does not end with a new line, at which parsing stops: use a copy
+  std::string line(p, eol);
+  line += '\n';
+  return parse_line(line.data(), line.data() + line.size() - 1, sample,
+      filename, f);
+}
 
-    int label;
-    size_t pos;
-    char separator;
-    double value;
-    size_t n_values = std::count_if(line.begin(), line.end(), is_colon);
+/**
+ * Sets values of a sample into a dense row of "shape" elements, which are
+ * "stride" apart
+ */
+struct assign {
 
-    std::istringstream iss(line);
-    iss >> label;
+  double* values;
+  ptrdiff_t stride;
+  size_t shape;
+  size_t sample;
+  const std::string& filename;
 
-    for (size_t k=0; k<n_values; ++k) {
-      iss >> pos >> separator >> value;
-      if (m_shape < pos) m_shape = pos;
+  void operator()(size_t index, double value) {
+    if (index > shape) {
+      boost::format s("sample %d of file '%s' has a value at index %d, but its samples have only %d entries");
+      s % sample % filename % index % shape;
+      throw std::runtime_error(s.str());
     }
+    values[(index-1) * stride] = value;
+  }
+
+};
+
+/**
+ * Smallest number of bytes of a file scanned or parsed by each thread
+ */
+static const size_t PARSE_GRAIN = 1 << 20;
+
+/**
+ * Smallest number of samples of a scanned file read by each thread
+ */
+static const size_t READ_GRAIN = 1024;
 
-    ++m_n_samples;
+/**
+ * Splits "data" to "end" in chunks of whole lines, one per thread, of at
+ * least PARSE_GRAIN bytes. Returns the bounds of the chunks.
+ */
+static std::vector<const char*> split_lines(const char* data,
+    const char* end, size_t threads) {
+  const size_t chunks = std::max((size_t)1,
+      std::min(threads, (size_t)(end - data) / PARSE_GRAIN));
+  std::vector<const char*> bound(chunks + 1, end);
+  bound[0] = data;
+  for (size_t k=1; k<chunks; ++k) {
+    const char* q = std::max(data + (end - data) / chunks * k, bound[k-1]);
+    const char* eol = static_cast<const char*>(memchr(q, '\n', end - q));
+    bound[k] = eol ? eol + 1 : end;
   }
+  return bound;
+}
 
-  //reset the file to then begin to read it properly
-  m_file.clear();
-  m_file.seekg(0, std::ios_base::beg);
+bob::learn::libsvm::File::File (const std::string& filename):
+  m_filename(filename),
+  m_data(0),
+  m_end(0),
+  m_next(0),
+  m_sample(0),
+  m_eof(false),
+  m_threads(bob::learn::libsvm::defaultThreads()),
+  m_scanned(false),
+  m_shape(0)
+{
+  try {
+    boost::interprocess::file_mapping file(filename.c_str(),
+        boost::interprocess::read_only);
+    //empty files cannot be mapped
+    if (boost::filesystem::file_size(filename))
+      m_region = boost::make_shared<boost::interprocess::mapped_region>(file,
+          boost::interprocess::read_only);
+  }
+  catch (std::exception& e) {
+    boost::format s("cannot open file '%s': %s");
+    s % filename % e.what();
+    throw std::runtime_error(s.str());
+  }
+
+  if (m_region) {
+    m_data = static_cast<const char*>(m_region->get_address());
+    m_end = m_data + m_region->get_size();
+  }
+  m_next = m_data;
 }
 
 bob::learn::libsvm::File::~File() {
 }
 
+void bob::learn::libsvm::File::setNumberOfThreads(size_t threads) {
+  m_threads = threads ? threads : boost::thread::hardware_concurrency();
+  if (!m_threads) m_threads = 1;
+}
+
+void bob::learn::libsvm::File::scan() const {
+
+  boost::lock_guard<boost::mutex> lock(m_mutex);
+  if (m_scanned) return;
+
+  //scans the whole file, to get the shape and where each sample starts
+  const std::vector<const char*> bound = split_lines(m_data, m_end,
+      m_threads);
+  const size_t chunks = bound.size() - 1;
+  std::vector<std::vector<size_t> > offsets(chunks);
+  std::vector<size_t> shape(chunks, 0);
+
+  auto scan_chunks = [&](size_t start, size_t stop) {
+    for (size_t k=start; k<stop; ++k) {
+      const char* next = bound[k];
+      const char* p;
+      const char* eol;
+      while (next_line(next, bound[k+1], p, eol)) {
+        offsets[k].push_back(p - m_data);
+        shape[k] = std::max(shape[k], max_index(p, eol));
+      }
+    }
+  };
+  bob::learn::libsvm::parallelFor(chunks, m_threads, 1,
+      boost::cref(scan_chunks));
+
+  size_t samples = 0;
+  for (size_t k=0; k<chunks; ++k) samples += offsets[k].size();
+  m_offsets.reserve(samples);
+  for (size_t k=0; k<chunks; ++k) {
+    m_offsets.insert(m_offsets.end(), offsets[k].begin(), offsets[k].end());
+    m_shape = std::max(m_shape, shape[k]);
+  }
+  m_scanned = true;
+
+}
+
 void bob::learn::libsvm::File::reset() {
-  m_file.close();
-  m_file.open(m_filename.c_str());
+  m_next = m_data;
+  m_sample = 0;
+  m_eof = false;
 }
 
 bool bob::learn::libsvm::File::read(int& label, blitz::Array<double,1>& values) {
-  if ((size_t)values.extent(0) != m_shape) {
+  if ((size_t)values.extent(0) != shape()) {
     boost::format s("file '%s' contains %d entries per sample, but you gave me an array with only %d positions");
     s % m_filename % m_shape % values.extent(0);
     throw std::runtime_error(s.str());
@@ -81,29 +277,108 @@ bool bob::learn::libsvm::File::read(int& label, blitz::Array<double,1>& values)
 bool bob::learn::libsvm::File::read_(int& label, blitz::Array<double,1>& values) {
 
   //if the file is at the end, just raise, you should have checked
-  if (!m_file.good()) return false;
+  if (!good()) return false;
+
+  assign set = {values.data(), values.stride(0), shape(), m_sample,
+    m_filename};
 
   //gets the next non-empty line
-  std::string line;
-  while (!line.size()) {
-    if (!m_file.good()) return false;
-    std::getline(m_file, line);
-    boost::trim(line);
+  const char* p;
+  const char* eol;
+  if (!next_line(m_next, m_end, p, eol)) {
+    m_eof = true;
+    return false;
   }
 
-  std::istringstream iss(line);
-  iss >> label;
+  values = 0; ///zero values all over as the data is sparse on the files
 
-  int pos;
-  char separator;
-  double value;
+  label = parse_sample(p, eol, m_end, m_sample++, m_filename, set);
 
-  values = 0; ///zero values all over as the data is sparse on the files
+  return true;
+}
+
+int bob::learn::libsvm::File::parse(size_t index, double* values,
+    ptrdiff_t stride) const {
+
+  const char* p = m_data + m_offsets[index];
+  const char* eol = static_cast<const char*>(memchr(p, '\n', m_end - p));
+  if (!eol) eol = m_end;
+
+  for (size_t j=0; j<m_shape; ++j) values[j * stride] = 0.;
+  assign set = {values, stride, m_shape, index, m_filename};
+  return parse_sample(p, eol, m_end, index, m_filename, set);
+
+}
 
-  for (size_t k=0; k<m_shape; ++k) {
-    iss >> pos >> separator >> value;
-    values(pos-1) = value;
+void bob::learn::libsvm::File::read(size_t index, int& label,
+    blitz::Array<double,1>& values) const {
+
+  if (index >= samples()) {
+    boost::format s("file '%s' contains %d samples, but you asked for sample %d");
+    s % m_filename % m_offsets.size() % index;
+    throw std::runtime_error(s.str());
   }
 
-  return true;
+  if ((size_t)values.extent(0) != m_shape) {
+    boost::format s("file '%s' contains %d entries per sample, but you gave me an array with only %d positions");
+    s % m_filename % m_shape % values.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  label = parse(index, values.data(), values.stride(0));
+
+}
+
+void bob::learn::libsvm::File::read(size_t start,
+    blitz::Array<int64_t,1>& labels, blitz::Array<double,2>& values) const {
+
+  const size_t count = labels.extent(0);
+
+  if (start > samples() || count > m_offsets.size() - start) {
+    boost::format s("file '%s' contains %d samples, but you asked for %d samples from sample %d");
+    s % m_filename % m_offsets.size() % count % start;
+    throw std::runtime_error(s.str());
+  }
+
+  if ((size_t)values.extent(0) != count ||
+      (size_t)values.extent(1) != m_shape) {
+    boost::format s("file '%s' contains %d entries per sample, but you gave me arrays for %d labels and %dx%d values");
+    s % m_filename % m_shape % count % values.extent(0) % values.extent(1);
+    throw std::runtime_error(s.str());
+  }
+
+  for (size_t k=0; k<count; ++k) {
+    labels(k) = parse(start + k, values.data() + k * values.stride(0),
+        values.stride(1));
+  }
+
+}
+
+void bob::learn::libsvm::File::readAll(blitz::Array<int64_t,1>& labels,
+    blitz::Array<double,2>& values) const {
+
+  //the file is scanned first, so values are parsed straight into the arrays
+  if (!labels.size() && !values.size()) {
+    labels.resize(samples());
+    values.resize(samples(), shape());
+  }
+
+  if ((size_t)labels.extent(0) != samples() ||
+      (size_t)values.extent(0) != samples() ||
+      (size_t)values.extent(1) != shape()) {
+    boost::format s("file '%s' contains %d samples of %d entries, but you gave me arrays for %d labels and %dx%d values");
+    s % m_filename % m_offsets.size() % m_shape % labels.extent(0);
+    s % values.extent(0) % values.extent(1);
+    throw std::runtime_error(s.str());
+  }
+
+  auto body = [&](size_t start, size_t stop) {
+    for (size_t k=start; k<stop; ++k) {
+      labels(k) = parse(k, values.data() + k * values.stride(0),
+          values.stride(1));
+    }
+  };
+  bob::learn::libsvm::parallelFor(m_offsets.size(), m_threads, READ_GRAIN,
+      boost::cref(body));
+
 }
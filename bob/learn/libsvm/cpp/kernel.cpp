@@ -0,0 +1,424 @@
+/**
+ * @date Fri 16 Oct 2026 14:02:17 CEST
+ *
+ * @brief Implementation of the vectorized kernel primitives, with run-time
+ * selection of the instruction set
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#include <bob.learn.libsvm/kernel.h>
+
+#include <algorithm>
+
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#  define BOB_LEARN_LIBSVM_X86_DISPATCH
+#  include <immintrin.h>
+#endif
+
+/**
+ * Plain implementations, summing in index order as libsvm does
+ */
+template <typename T>
+static void dot_scalar(const T* x, const T* y, size_t stride, size_t rows,
+    size_t size, T* output) {
+  for (size_t i=0; i<rows; ++i, y+=stride) {
+    T sum = 0;
+    for (size_t k=0; k<size; ++k) sum += x[k] * y[k];
+    output[i] = sum;
+  }
+}
+
+/**
+ * Dot products between 4 consecutive rows of "x" and "y", each computed
+ * exactly as the matching dot() implementation does
+ */
+template <typename T>
+static void dot4_scalar(const T* x, size_t x_stride, const T* y, size_t size,
+    T* output, size_t output_stride) {
+  for (size_t r=0; r<4; ++r, x+=x_stride, output+=output_stride) {
+    dot_scalar(x, y, 0, 1, size, output);
+  }
+}
+
+#ifdef BOB_LEARN_LIBSVM_X86_DISPATCH
+
+__attribute__((target("avx2,fma")))
+static inline double hsum_avx2(__m256d v) {
+  __m128d lo = _mm256_castpd256_pd128(v);
+  __m128d hi = _mm256_extractf128_pd(v, 1);
+  lo = _mm_add_pd(lo, hi);
+  return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2,fma")))
+static void dot_avx2(const double* x, const double* y, size_t stride,
+    size_t rows, size_t size, double* output) {
+  const size_t blocks = size & ~(size_t)7;
+  for (size_t i=0; i<rows; ++i, y+=stride) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t k = 0;
+    for (; k<blocks; k+=8) {
+      acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x+k), _mm256_loadu_pd(y+k), acc0);
+      acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(x+k+4), _mm256_loadu_pd(y+k+4),
+          acc1);
+    }
+    double sum = hsum_avx2(_mm256_add_pd(acc0, acc1));
+    for (; k<size; ++k) sum += x[k] * y[k];
+    output[i] = sum;
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void dot4_avx2(const double* x, size_t x_stride, const double* y,
+    size_t size, double* output, size_t output_stride) {
+  const double* x0 = x;
+  const double* x1 = x0 + x_stride;
+  const double* x2 = x1 + x_stride;
+  const double* x3 = x2 + x_stride;
+  const size_t blocks = size & ~(size_t)7;
+  __m256d acc00 = _mm256_setzero_pd(), acc01 = _mm256_setzero_pd();
+  __m256d acc10 = _mm256_setzero_pd(), acc11 = _mm256_setzero_pd();
+  __m256d acc20 = _mm256_setzero_pd(), acc21 = _mm256_setzero_pd();
+  __m256d acc30 = _mm256_setzero_pd(), acc31 = _mm256_setzero_pd();
+  size_t k = 0;
+  for (; k<blocks; k+=8) {
+    __m256d y0 = _mm256_loadu_pd(y+k);
+    __m256d y1 = _mm256_loadu_pd(y+k+4);
+    acc00 = _mm256_fmadd_pd(_mm256_loadu_pd(x0+k), y0, acc00);
+    acc01 = _mm256_fmadd_pd(_mm256_loadu_pd(x0+k+4), y1, acc01);
+    acc10 = _mm256_fmadd_pd(_mm256_loadu_pd(x1+k), y0, acc10);
+    acc11 = _mm256_fmadd_pd(_mm256_loadu_pd(x1+k+4), y1, acc11);
+    acc20 = _mm256_fmadd_pd(_mm256_loadu_pd(x2+k), y0, acc20);
+    acc21 = _mm256_fmadd_pd(_mm256_loadu_pd(x2+k+4), y1, acc21);
+    acc30 = _mm256_fmadd_pd(_mm256_loadu_pd(x3+k), y0, acc30);
+    acc31 = _mm256_fmadd_pd(_mm256_loadu_pd(x3+k+4), y1, acc31);
+  }
+  double sum0 = hsum_avx2(_mm256_add_pd(acc00, acc01));
+  double sum1 = hsum_avx2(_mm256_add_pd(acc10, acc11));
+  double sum2 = hsum_avx2(_mm256_add_pd(acc20, acc21));
+  double sum3 = hsum_avx2(_mm256_add_pd(acc30, acc31));
+  for (; k<size; ++k) {
+    sum0 += x0[k] * y[k];
+    sum1 += x1[k] * y[k];
+    sum2 += x2[k] * y[k];
+    sum3 += x3[k] * y[k];
+  }
+  output[0] = sum0;
+  output[output_stride] = sum1;
+  output[2*output_stride] = sum2;
+  output[3*output_stride] = sum3;
+}
+
+__attribute__((target("avx2,fma")))
+static inline float hsum_avx2(__m256 v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  return _mm_cvtss_f32(_mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1)));
+}
+
+__attribute__((target("avx2,fma")))
+static void dot_avx2(const float* x, const float* y, size_t stride,
+    size_t rows, size_t size, float* output) {
+  const size_t blocks = size & ~(size_t)15;
+  for (size_t i=0; i<rows; ++i, y+=stride) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k<blocks; k+=16) {
+      acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x+k), _mm256_loadu_ps(y+k), acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x+k+8), _mm256_loadu_ps(y+k+8),
+          acc1);
+    }
+    float sum = hsum_avx2(_mm256_add_ps(acc0, acc1));
+    for (; k<size; ++k) sum += x[k] * y[k];
+    output[i] = sum;
+  }
+}
+
+__attribute__((target("avx2,fma")))
+static void dot4_avx2(const float* x, size_t x_stride, const float* y,
+    size_t size, float* output, size_t output_stride) {
+  const float* x0 = x;
+  const float* x1 = x0 + x_stride;
+  const float* x2 = x1 + x_stride;
+  const float* x3 = x2 + x_stride;
+  const size_t blocks = size & ~(size_t)15;
+  __m256 acc00 = _mm256_setzero_ps(), acc01 = _mm256_setzero_ps();
+  __m256 acc10 = _mm256_setzero_ps(), acc11 = _mm256_setzero_ps();
+  __m256 acc20 = _mm256_setzero_ps(), acc21 = _mm256_setzero_ps();
+  __m256 acc30 = _mm256_setzero_ps(), acc31 = _mm256_setzero_ps();
+  size_t k = 0;
+  for (; k<blocks; k+=16) {
+    __m256 y0 = _mm256_loadu_ps(y+k);
+    __m256 y1 = _mm256_loadu_ps(y+k+8);
+    acc00 = _mm256_fmadd_ps(_mm256_loadu_ps(x0+k), y0, acc00);
+    acc01 = _mm256_fmadd_ps(_mm256_loadu_ps(x0+k+8), y1, acc01);
+    acc10 = _mm256_fmadd_ps(_mm256_loadu_ps(x1+k), y0, acc10);
+    acc11 = _mm256_fmadd_ps(_mm256_loadu_ps(x1+k+8), y1, acc11);
+    acc20 = _mm256_fmadd_ps(_mm256_loadu_ps(x2+k), y0, acc20);
+    acc21 = _mm256_fmadd_ps(_mm256_loadu_ps(x2+k+8), y1, acc21);
+    acc30 = _mm256_fmadd_ps(_mm256_loadu_ps(x3+k), y0, acc30);
+    acc31 = _mm256_fmadd_ps(_mm256_loadu_ps(x3+k+8), y1, acc31);
+  }
+  float sum0 = hsum_avx2(_mm256_add_ps(acc00, acc01));
+  float sum1 = hsum_avx2(_mm256_add_ps(acc10, acc11));
+  float sum2 = hsum_avx2(_mm256_add_ps(acc20, acc21));
+  float sum3 = hsum_avx2(_mm256_add_ps(acc30, acc31));
+  for (; k<size; ++k) {
+    sum0 += x0[k] * y[k];
+    sum1 += x1[k] * y[k];
+    sum2 += x2[k] * y[k];
+    sum3 += x3[k] * y[k];
+  }
+  output[0] = sum0;
+  output[output_stride] = sum1;
+  output[2*output_stride] = sum2;
+  output[3*output_stride] = sum3;
+}
+
+__attribute__((target("avx512f")))
+static void dot_avx512(const double* x, const double* y, size_t stride,
+    size_t rows, size_t size, double* output) {
+  const size_t blocks = size & ~(size_t)15;
+  for (size_t i=0; i<rows; ++i, y+=stride) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    size_t k = 0;
+    for (; k<blocks; k+=16) {
+      acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(x+k), _mm512_loadu_pd(y+k), acc0);
+      acc1 = _mm512_fmadd_pd(_mm512_loadu_pd(x+k+8), _mm512_loadu_pd(y+k+8),
+          acc1);
+    }
+    if (size - k >= 8) {
+      acc0 = _mm512_fmadd_pd(_mm512_loadu_pd(x+k), _mm512_loadu_pd(y+k), acc0);
+      k += 8;
+    }
+    double sum = _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+    for (; k<size; ++k) sum += x[k] * y[k];
+    output[i] = sum;
+  }
+}
+
+__attribute__((target("avx512f")))
+static void dot4_avx512(const double* x, size_t x_stride, const double* y,
+    size_t size, double* output, size_t output_stride) {
+  const double* x0 = x;
+  const double* x1 = x0 + x_stride;
+  const double* x2 = x1 + x_stride;
+  const double* x3 = x2 + x_stride;
+  const size_t blocks = size & ~(size_t)15;
+  __m512d acc00 = _mm512_setzero_pd(), acc01 = _mm512_setzero_pd();
+  __m512d acc10 = _mm512_setzero_pd(), acc11 = _mm512_setzero_pd();
+  __m512d acc20 = _mm512_setzero_pd(), acc21 = _mm512_setzero_pd();
+  __m512d acc30 = _mm512_setzero_pd(), acc31 = _mm512_setzero_pd();
+  size_t k = 0;
+  for (; k<blocks; k+=16) {
+    __m512d y0 = _mm512_loadu_pd(y+k);
+    __m512d y1 = _mm512_loadu_pd(y+k+8);
+    acc00 = _mm512_fmadd_pd(_mm512_loadu_pd(x0+k), y0, acc00);
+    acc01 = _mm512_fmadd_pd(_mm512_loadu_pd(x0+k+8), y1, acc01);
+    acc10 = _mm512_fmadd_pd(_mm512_loadu_pd(x1+k), y0, acc10);
+    acc11 = _mm512_fmadd_pd(_mm512_loadu_pd(x1+k+8), y1, acc11);
+    acc20 = _mm512_fmadd_pd(_mm512_loadu_pd(x2+k), y0, acc20);
+    acc21 = _mm512_fmadd_pd(_mm512_loadu_pd(x2+k+8), y1, acc21);
+    acc30 = _mm512_fmadd_pd(_mm512_loadu_pd(x3+k), y0, acc30);
+    acc31 = _mm512_fmadd_pd(_mm512_loadu_pd(x3+k+8), y1, acc31);
+  }
+  if (size - k >= 8) {
+    __m512d y0 = _mm512_loadu_pd(y+k);
+    acc00 = _mm512_fmadd_pd(_mm512_loadu_pd(x0+k), y0, acc00);
+    acc10 = _mm512_fmadd_pd(_mm512_loadu_pd(x1+k), y0, acc10);
+    acc20 = _mm512_fmadd_pd(_mm512_loadu_pd(x2+k), y0, acc20);
+    acc30 = _mm512_fmadd_pd(_mm512_loadu_pd(x3+k), y0, acc30);
+    k += 8;
+  }
+  double sum0 = _mm512_reduce_add_pd(_mm512_add_pd(acc00, acc01));
+  double sum1 = _mm512_reduce_add_pd(_mm512_add_pd(acc10, acc11));
+  double sum2 = _mm512_reduce_add_pd(_mm512_add_pd(acc20, acc21));
+  double sum3 = _mm512_reduce_add_pd(_mm512_add_pd(acc30, acc31));
+  for (; k<size; ++k) {
+    sum0 += x0[k] * y[k];
+    sum1 += x1[k] * y[k];
+    sum2 += x2[k] * y[k];
+    sum3 += x3[k] * y[k];
+  }
+  output[0] = sum0;
+  output[output_stride] = sum1;
+  output[2*output_stride] = sum2;
+  output[3*output_stride] = sum3;
+}
+
+__attribute__((target("avx512f")))
+static void dot_avx512(const float* x, const float* y, size_t stride,
+    size_t rows, size_t size, float* output) {
+  const size_t blocks = size & ~(size_t)31;
+  for (size_t i=0; i<rows; ++i, y+=stride) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t k = 0;
+    for (; k<blocks; k+=32) {
+      acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(x+k), _mm512_loadu_ps(y+k), acc0);
+      acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(x+k+16), _mm512_loadu_ps(y+k+16),
+          acc1);
+    }
+    if (size - k >= 16) {
+      acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(x+k), _mm512_loadu_ps(y+k), acc0);
+      k += 16;
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    for (; k<size; ++k) sum += x[k] * y[k];
+    output[i] = sum;
+  }
+}
+
+__attribute__((target("avx512f")))
+static void dot4_avx512(const float* x, size_t x_stride, const float* y,
+    size_t size, float* output, size_t output_stride) {
+  const float* x0 = x;
+  const float* x1 = x0 + x_stride;
+  const float* x2 = x1 + x_stride;
+  const float* x3 = x2 + x_stride;
+  const size_t blocks = size & ~(size_t)31;
+  __m512 acc00 = _mm512_setzero_ps(), acc01 = _mm512_setzero_ps();
+  __m512 acc10 = _mm512_setzero_ps(), acc11 = _mm512_setzero_ps();
+  __m512 acc20 = _mm512_setzero_ps(), acc21 = _mm512_setzero_ps();
+  __m512 acc30 = _mm512_setzero_ps(), acc31 = _mm512_setzero_ps();
+  size_t k = 0;
+  for (; k<blocks; k+=32) {
+    __m512 y0 = _mm512_loadu_ps(y+k);
+    __m512 y1 = _mm512_loadu_ps(y+k+16);
+    acc00 = _mm512_fmadd_ps(_mm512_loadu_ps(x0+k), y0, acc00);
+    acc01 = _mm512_fmadd_ps(_mm512_loadu_ps(x0+k+16), y1, acc01);
+    acc10 = _mm512_fmadd_ps(_mm512_loadu_ps(x1+k), y0, acc10);
+    acc11 = _mm512_fmadd_ps(_mm512_loadu_ps(x1+k+16), y1, acc11);
+    acc20 = _mm512_fmadd_ps(_mm512_loadu_ps(x2+k), y0, acc20);
+    acc21 = _mm512_fmadd_ps(_mm512_loadu_ps(x2+k+16), y1, acc21);
+    acc30 = _mm512_fmadd_ps(_mm512_loadu_ps(x3+k), y0, acc30);
+    acc31 = _mm512_fmadd_ps(_mm512_loadu_ps(x3+k+16), y1, acc31);
+  }
+  if (size - k >= 16) {
+    __m512 y0 = _mm512_loadu_ps(y+k);
+    acc00 = _mm512_fmadd_ps(_mm512_loadu_ps(x0+k), y0, acc00);
+    acc10 = _mm512_fmadd_ps(_mm512_loadu_ps(x1+k), y0, acc10);
+    acc20 = _mm512_fmadd_ps(_mm512_loadu_ps(x2+k), y0, acc20);
+    acc30 = _mm512_fmadd_ps(_mm512_loadu_ps(x3+k), y0, acc30);
+    k += 16;
+  }
+  float sum0 = _mm512_reduce_add_ps(_mm512_add_ps(acc00, acc01));
+  float sum1 = _mm512_reduce_add_ps(_mm512_add_ps(acc10, acc11));
+  float sum2 = _mm512_reduce_add_ps(_mm512_add_ps(acc20, acc21));
+  float sum3 = _mm512_reduce_add_ps(_mm512_add_ps(acc30, acc31));
+  for (; k<size; ++k) {
+    sum0 += x0[k] * y[k];
+    sum1 += x1[k] * y[k];
+    sum2 += x2[k] * y[k];
+    sum3 += x3[k] * y[k];
+  }
+  output[0] = sum0;
+  output[output_stride] = sum1;
+  output[2*output_stride] = sum2;
+  output[3*output_stride] = sum3;
+}
+
+#endif /* BOB_LEARN_LIBSVM_X86_DISPATCH */
+
+template <typename T> using rows_function =
+  void (*)(const T*, const T*, size_t, size_t, size_t, T*);
+template <typename T> using block_function =
+  void (*)(const T*, size_t, const T*, size_t, T*, size_t);
+
+/**
+ * The set of primitives selected for this CPU
+ */
+struct implementation {
+  const char* name;
+  rows_function<double> dot;
+  block_function<double> dot4;
+  rows_function<float> dot_f;
+  block_function<float> dot4_f;
+};
+
+static implementation select_implementation() {
+#ifdef BOB_LEARN_LIBSVM_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    implementation retval = {"avx512f", dot_avx512, dot4_avx512,
+      dot_avx512, dot4_avx512};
+    return retval;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    implementation retval = {"avx2", dot_avx2, dot4_avx2, dot_avx2,
+      dot4_avx2};
+    return retval;
+  }
+#endif
+  implementation retval = {"scalar", dot_scalar<double>,
+    dot4_scalar<double>, dot_scalar<float>, dot4_scalar<float>};
+  return retval;
+}
+
+static const implementation s_implementation = select_implementation();
+
+void bob::learn::libsvm::dot(const double* x, const double* y,
+    size_t stride, size_t rows, size_t size, double* output) {
+  s_implementation.dot(x, y, stride, rows, size, output);
+}
+
+void bob::learn::libsvm::dot(const float* x, const float* y,
+    size_t stride, size_t rows, size_t size, float* output) {
+  s_implementation.dot_f(x, y, stride, rows, size, output);
+}
+
+/**
+ * Columns of "y" are processed in tiles of about this size, in bytes, so
+ * they stay in the L2 cache while all rows of "x" are run against them
+ */
+static const size_t TILE_BYTES = 128 * 1024;
+
+/**
+ * Built-in matrix product, see dot() in kernel.h
+ */
+template <typename T>
+static void dot_block(rows_function<T> dot, block_function<T> dot4,
+    const T* x, size_t x_stride, size_t rows, const T* y, size_t y_stride,
+    size_t columns, size_t size, T* output, size_t output_stride) {
+  const size_t tile = std::max((size_t)1,
+      TILE_BYTES / (std::max(size, (size_t)1) * sizeof(T)));
+  for (size_t j0=0; j0<columns; j0+=tile) {
+    const size_t j1 = std::min(columns, j0 + tile);
+    size_t i = 0;
+    for (; i+4<=rows; i+=4) {
+      for (size_t j=j0; j<j1; ++j) {
+        dot4(x + i*x_stride, x_stride, y + j*y_stride, size,
+            output + i*output_stride + j, output_stride);
+      }
+    }
+    for (; i<rows; ++i) {
+      dot(x + i*x_stride, y + j0*y_stride, y_stride, j1 - j0, size,
+          output + i*output_stride + j0);
+    }
+  }
+}
+
+void bob::learn::libsvm::dot(const double* x, size_t x_stride, size_t rows,
+    const double* y, size_t y_stride, size_t columns, size_t size,
+    double* output, size_t output_stride) {
+  dot_block(s_implementation.dot, s_implementation.dot4, x, x_stride, rows,
+      y, y_stride, columns, size, output, output_stride);
+}
+
+void bob::learn::libsvm::dot(const float* x, size_t x_stride, size_t rows,
+    const float* y, size_t y_stride, size_t columns, size_t size,
+    float* output, size_t output_stride) {
+  dot_block(s_implementation.dot_f, s_implementation.dot4_f, x, x_stride,
+      rows, y, y_stride, columns, size, output, output_stride);
+}
+
+const char* bob::learn::libsvm::instructionSet() {
+  return s_implementation.name;
+}
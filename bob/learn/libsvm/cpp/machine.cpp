@@ -8,86 +8,56 @@
  */
 
 #include <bob.learn.libsvm/machine.h>
-
-#include <sys/stat.h>
+#include <bob.learn.libsvm/parallel.h>
+#include <bob.learn.libsvm/kernel.h>
+#include <bob.learn.libsvm/model.h>
+#include <bob.learn.libsvm/binary.h>
+
+#include <vector>
+#include <atomic>
+#include <type_traits>
+#include <limits>
 #include <boost/format.hpp>
-#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/align/aligned_alloc.hpp>
+#include <boost/ref.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <bob.core/check.h>
 #include <bob.core/logging.h>
 
 
-std::string bob::learn::libsvm::_tmpdir() {
-  const char* value = getenv("TMPDIR");
-  if (value)
-    return value;
-  else
-    return "/tmp";
-}
-
-std::string bob::learn::libsvm::_tmpfile(const std::string& extension) {
-  boost::filesystem::path tpl = bob::learn::libsvm::_tmpdir();
-  tpl /= std::string("bob_tmpfile_XXXXXX");
-  boost::shared_array<char> char_tpl(new char[tpl.string().size()+1]);
-  strcpy(char_tpl.get(), tpl.string().c_str());
-#ifdef _WIN32
-  mktemp(char_tpl.get());
-#else
-  int fd = mkstemp(char_tpl.get());
-  close(fd);
-  boost::filesystem::remove(char_tpl.get());
-#endif
-  std::string res = char_tpl.get();
-  res += extension;
-  return res;
-}
-
-
-/**
- * A wrapper, to standardize this function.
- */
-static void svm_model_free(svm_model*& m) {
-#if LIBSVM_VERSION >= 300
-  svm_free_and_destroy_model(&m);
-#else
-  svm_destroy_model(m);
-#endif
-}
-
 blitz::Array<uint8_t,1> bob::learn::libsvm::svm_pickle
 (const boost::shared_ptr<svm_model> model)
 {
-  std::string tmp_filename = bob::learn::libsvm::_tmpfile(".svm");
-
-  //save it to a temporary file
-  if (svm_save_model(tmp_filename.c_str(), model.get())) {
-    boost::format s("cannot save SVM to file `%s' while copying model");
-    s % tmp_filename;
-    throw std::runtime_error(s.str());
-  }
-
-  //gets total size of file
-  struct stat filestatus;
-  stat(tmp_filename.c_str(), &filestatus);
-
-  //reload the data from the file in binary format
-  std::ifstream binfile(tmp_filename.c_str(), std::ios::binary);
-  blitz::Array<uint8_t,1> buffer(filestatus.st_size);
-  binfile.read(reinterpret_cast<char*>(buffer.data()), filestatus.st_size);
-
-  //unlink the temporary file
-  boost::filesystem::remove(tmp_filename);
-
-  //finally, return the pickled data
+  const std::string text = bob::learn::libsvm::svm_format(model.get());
+  blitz::Array<uint8_t,1> buffer(text.size());
+  std::copy(text.begin(), text.end(), buffer.data());
   return buffer;
 }
 
-static boost::shared_ptr<svm_model> make_model(const char* filename) {
-  boost::shared_ptr<svm_model> retval(svm_load_model(filename),
-      std::ptr_fun(svm_model_free));
-#if LIBSVM_VERSION > 315
-  if (retval) retval->sv_indices = 0; ///< force initialization: see ticket #109
-#endif
-  return retval;
+/**
+ * Loads a model in libsvm's text format. The file is mapped into memory and
+ * parsed by svm_parse(), on the default number of threads, instead of being
+ * read by svm_load_model(), which is not threaded.
+ */
+static boost::shared_ptr<svm_model> make_model(const std::string& filename) {
+  boost::interprocess::mapped_region region;
+  try {
+    boost::interprocess::file_mapping file(filename.c_str(),
+        boost::interprocess::read_only);
+    boost::interprocess::mapped_region(file,
+        boost::interprocess::read_only).swap(region);
+  }
+  catch (std::exception& e) {
+    boost::format s("cannot open model file '%s': %s");
+    s % filename % e.what();
+    throw std::runtime_error(s.str());
+  }
+  region.advise(boost::interprocess::mapped_region::advice_sequential);
+  return bob::learn::libsvm::svm_parse(
+      static_cast<const char*>(region.get_address()), region.get_size(),
+      bob::learn::libsvm::defaultThreads());
 }
 
 /**
@@ -95,62 +65,128 @@ static boost::shared_ptr<svm_model> make_model(const char* filename) {
  */
 boost::shared_ptr<svm_model> bob::learn::libsvm::svm_unpickle
 (const blitz::Array<uint8_t,1>& buffer) {
-
-  std::string tmp_filename = bob::learn::libsvm::_tmpfile(".svm");
-
-  std::ofstream binfile(tmp_filename.c_str(), std::ios::binary);
-  binfile.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
-  binfile.close();
-
-  //reload the file using the appropriate libsvm loading method
-  boost::shared_ptr<svm_model> retval = make_model(tmp_filename.c_str());
-
-  if (!retval) {
-    boost::format s("cannot open model file '%s'");
-    s % tmp_filename;
-    throw std::runtime_error(s.str());
+  if (!bob::core::array::isCContiguous(buffer)) {
+    blitz::Array<uint8_t,1> copy(buffer.copy());
+    return svm_unpickle(copy);
   }
+  return bob::learn::libsvm::svm_parse(
+      reinterpret_cast<const char*>(buffer.data()), buffer.size());
+}
 
-  //unlinks the temporary file
-  boost::filesystem::remove(tmp_filename);
+/**
+ * Size of a cache line in bytes, used to align dense support vectors
+ */
+static const size_t CACHE_LINE = 64;
 
-  //finally, return the pickled data
-  return retval;
+/**
+ * Tells if all support vectors of a model have indices from 1 on. Entries at
+ * lower indices have no dense column, but libsvm counts them in the norms of
+ * the support vectors, so RBF kernels would differ from libsvm's.
+ */
+static bool one_based(const svm_model* model) {
+  for (int k=0; k<model->l; ++k) {
+    for (const svm_node* it = model->SV[k]; it->index != -1; ++it) {
+      if (it->index < 1) return false;
+    }
+  }
+  return true;
 }
 
 void bob::learn::libsvm::Machine::reset() {
   //gets the expected size for the input from the SVM
-  m_input_size = 0;
+  size_t input_size = 0;
+  size_t nodes = 0; ///< total number of libsvm nodes, including terminators
   for (int k=0; k<m_model->l; ++k) {
     svm_node* end = m_model->SV[k];
     while (end->index != -1) {
-      if (end->index > (int)m_input_size) m_input_size = end->index;
+      if (end->index > (int)input_size) input_size = end->index;
       ++end;
     }
+    nodes += end - m_model->SV[k] + 1;
   }
 
-  //create and reset cache
-  m_input_cache.reset(new svm_node[1 + m_input_size]);
+  initialize(input_size);
+
+  //LINEAR models are collapsed into their weight vectors; others use the
+  //dense evaluator unless it would take more memory than the libsvm nodes,
+  //which is the case for very sparse models, or they have indices below 1
+  setCollapsed(kernelType() == LINEAR);
+  setDense(kernelType() != PRECOMPUTED && !isCollapsed() &&
+      one_based(m_model.get()) && m_model->l * m_stride <= 2 * nodes);
+}
+
+void bob::learn::libsvm::Machine::initialize(size_t input_size) {
+  m_input_size = input_size;
 
   m_input_sub.resize(inputSize());
   m_input_sub = 0.0;
   m_input_div.resize(inputSize());
   m_input_div = 1.0;
+  m_input_mul.resize(inputSize());
+  m_input_mul = 1.0;
+  m_input_scaled = false;
+
+  m_threads = bob::learn::libsvm::defaultThreads();
+  m_early = true;
+  m_single = false;
+  m_bits = 0;
+  //only nodes allocated by libsvm's loader, for this machine, can be released
+  m_compact = m_owned && m_model->free_sv;
+  m_released = false;
+
+  //dense rows start at cache line boundaries
+  const size_t per_line = CACHE_LINE / sizeof(double);
+  m_stride = per_line * ((m_input_size + per_line - 1) / per_line);
+  const size_t per_line_f = CACHE_LINE / sizeof(float);
+  m_fstride = per_line_f * ((m_input_size + per_line_f - 1) / per_line_f);
+}
+
+void bob::learn::libsvm::Machine::load
+(const bob::learn::libsvm::binary_model& binary) {
+
+  m_model = binary.model;
+  initialize(binary.input_size);
+
+  if (binary.sv && binary.stride != m_stride) {
+    boost::format s("dense support vectors of binary model files should be padded to %d values, not %d - convert the original model again");
+    s % m_stride % binary.stride;
+    throw std::runtime_error(s.str());
+  }
+
+  m_input_sub.reference(binary.input_sub);
+  m_input_div.reference(binary.input_div);
+
+  //dense support vectors, their coefficients and norms are used from the
+  //file, as they are: libsvm's nodes are only built if needed
+  m_sv = binary.sv;
+  m_sv_coef = binary.sv_coef;
+  m_sv_norms = binary.sv_norms;
+  m_compact = m_released = isDense();
+  if (!releasable()) setCompact(false);
+
+  if (kernelType() == LINEAR) {
+    setCollapsed(true);
+    setDense(false);
+  }
+  else updateScaling();
+
 }
 
 bob::learn::libsvm::Machine::Machine(const std::string& model_file):
-  m_model(make_model(model_file.c_str()))
+  m_model(),
+  m_owned(true)
 {
-  if (!m_model) {
-    boost::format s("cannot open model file '%s'");
-    s % model_file;
-    throw std::runtime_error(s.str());
+  if (bob::learn::libsvm::svm_is_binary(model_file)) {
+    load(bob::learn::libsvm::svm_map_binary(model_file));
+    return;
   }
+  m_model = make_model(model_file);
   reset();
 }
 
 bob::learn::libsvm::Machine::Machine(bob::io::base::HDF5File& config):
-  m_model()
+  m_model(),
+  m_owned(true)
 {
   uint64_t version = 0;
   config.getAttribute(".", "version", version);
@@ -160,14 +196,21 @@ bob::learn::libsvm::Machine::Machine(bob::io::base::HDF5File& config):
     m % config.filename() % config.cwd() % version % LIBSVM_VERSION;
     bob::core::warn << m.str() << std::endl;
   }
-  m_model = bob::learn::libsvm::svm_unpickle(config.readArray<uint8_t,1>("svm_model"));
+  //files written by earlier versions hold the model in libsvm's text format
+  if (config.contains("svm_type"))
+    m_model = bob::learn::libsvm::svm_read_hdf5(config);
+  else
+    m_model = bob::learn::libsvm::svm_unpickle(config.readArray<uint8_t,1>("svm_model"));
   reset(); ///< note: has to be done before reading scaling parameters
   config.readArray("input_subtract", m_input_sub);
   config.readArray("input_divide", m_input_div);
+  updateScaling();
 }
 
-bob::learn::libsvm::Machine::Machine(boost::shared_ptr<svm_model> model)
-  : m_model(model)
+bob::learn::libsvm::Machine::Machine(boost::shared_ptr<svm_model> model,
+    bool owned)
+  : m_model(model),
+  m_owned(owned)
 {
   if (!m_model) {
     throw std::runtime_error("null SVM model cannot be processed");
@@ -247,6 +290,7 @@ void bob::learn::libsvm::Machine::setInputSubtraction(const blitz::Array<double,
     throw std::runtime_error(m.str());
   }
   m_input_sub.reference(bob::core::array::ccopy(v));
+  updateScaling();
 }
 
 void bob::learn::libsvm::Machine::setInputDivision(const blitz::Array<double,1>& v) {
@@ -256,20 +300,27 @@ void bob::learn::libsvm::Machine::setInputDivision(const blitz::Array<double,1>&
     throw std::runtime_error(m.str());
   }
   m_input_div.reference(bob::core::array::ccopy(v));
+  updateScaling();
 }
 
 /**
  * Copies the user input to a locally pre-allocated cache. Apply normalization
- * at the same occasion.
+ * at the same occasion, multiplying by the reciprocals "mul" of the division
+ * factors; "sub" is null if the scaling does not change the input. The input
+ * is read from "input" with a "stride" between consecutive elements, so rows
+ * and columns of larger arrays can be copied without creating intermediate
+ * blitz views. Inputs of type "I" (double or float) are converted on the
+ * way.
  */
-static inline void copy(const blitz::Array<double,1>& input,
-    size_t cache_size, boost::shared_array<svm_node>& cache,
-    const blitz::Array<double,1>& sub, const blitz::Array<double,1>& div) {
+template <typename I>
+static inline void copy(const I* input, ptrdiff_t stride,
+    size_t cache_size, svm_node* cache,
+    const double* sub, const double* mul) {
 
   size_t cur = 0; ///< currently used index
 
   for (size_t k=0; k<cache_size; ++k) {
-    double tmp = (input(k) - sub(k))/div(k);
+    double tmp = sub? (input[k*stride] - sub[k])*mul[k] : input[k*stride];
     if (!tmp) continue;
     cache[cur].index = k+1;
     cache[cur].value = tmp;
@@ -279,108 +330,1838 @@ static inline void copy(const blitz::Array<double,1>& input,
   cache[cur].index = -1; //libsvm detects end of input if index==-1
 }
 
-int bob::learn::libsvm::Machine::predictClass_
-(const blitz::Array<double,1>& input) const {
-  copy(input, m_input_size, m_input_cache, m_input_sub, m_input_div);
-  int retval = round(svm_predict(m_model.get(), m_input_cache.get()));
-  return retval;
+/**
+ * Same as above, for the "size" non-zero values of a sparse input, at the
+ * 0-based and increasing columns "index". Columns from "cache_size" on are
+ * ignored. The input subtraction must be zero: only the reciprocals "mul" of
+ * the division factors are applied, unless null.
+ */
+static inline void copy_sparse(const int64_t* index, const double* value,
+    size_t size, size_t cache_size, svm_node* cache, const double* mul) {
+
+  size_t cur = 0; ///< currently used index
+
+  for (size_t k=0; k<size && (size_t)index[k]<cache_size; ++k) {
+    double tmp = mul? value[k]*mul[index[k]] : value[k];
+    if (!tmp) continue;
+    cache[cur].index = index[k]+1;
+    cache[cur].value = tmp;
+    ++cur;
+  }
+
+  cache[cur].index = -1;
 }
 
-int bob::learn::libsvm::Machine::predictClass
-(const blitz::Array<double,1>& input) const {
+/**
+ * Writes the "size" non-zero values of a sparse input, at the 0-based and
+ * increasing columns "index", to a dense "row" of "row_size" elements
+ */
+static inline void scatter(const int64_t* index, const double* value,
+    size_t size, size_t row_size, double* row) {
+  std::fill(row, row + row_size, 0.);
+  for (size_t k=0; k<size && (size_t)index[k]<row_size; ++k) {
+    row[index[k]] = value[k];
+  }
+}
 
-  if ((size_t)input.extent(0) < inputSize()) {
-    boost::format s("input for this SVM should have **at least** %d components, but you provided an array with %d elements instead");
-    s % inputSize() % input.extent(0);
-    throw std::runtime_error(s.str());
+/**
+ * Same as above, but for the dense evaluator: scaled values are written to
+ * every position of "output", including zeros, in the precision "T"
+ * predictions run in.
+ */
+template <typename I, typename T>
+static inline void copy(const I* input, ptrdiff_t stride,
+    size_t size, T* output, const double* sub, const double* mul) {
+  if (!sub) {
+    for (size_t k=0; k<size; ++k) output[k] = input[k*stride];
+    return;
   }
+  for (size_t k=0; k<size; ++k) output[k] = (input[k*stride] - sub[k])*mul[k];
+}
 
-  return predictClass_(input);
+/**
+ * Identifies the scratch buffers used during prediction, so that each of
+ * them gets its own memory.
+ */
+enum scratch_t {
+  NODES, ///< input converted to libsvm nodes
+  INPUT, ///< scaled input, dense
+  KERNEL, ///< kernel values between the input and every support vector
+  DECISION, ///< values of the decision functions
+  VOTES, ///< votes per class on multi-class problems
+  EVALUATED, ///< decision functions evaluated so far, with early voting
+  STARTS, ///< index of the first support vector of every class
+  PARTIAL, ///< partial decision values, per class block
+  PRODUCTS, ///< dot products with the weight vectors of collapsed models
+  SCALED, ///< inputs multiplied by the quantization scales
+  OFFSETS, ///< dot products of the inputs with the quantization offsets
+  DECODED, ///< tile of decoded support vectors
+  REFERENCE, ///< decision values computed by libsvm, for comparison
+  PAIRWISE, ///< pair-wise probabilities
+  QMATRIX, ///< temporary memory for multi-class probabilities
+  SCATTERED ///< sparse inputs, scattered into dense rows
+};
+
+/**
+ * Heap allocations made by the prediction methods, see
+ * Machine::allocations()
+ */
+static std::atomic<size_t> s_allocations(0);
+
+size_t bob::learn::libsvm::Machine::allocations() {
+  return s_allocations.load(std::memory_order_relaxed);
 }
 
-int bob::learn::libsvm::Machine::predictClassAndScores_
-(const blitz::Array<double,1>& input,
- blitz::Array<double,1>& scores) const {
-  copy(input, m_input_size, m_input_cache, m_input_sub, m_input_div);
-#if LIBSVM_VERSION > 290
-  int retval = round(svm_predict_values(m_model.get(), m_input_cache.get(), scores.data()));
-#else
-  svm_predict_values(m_model.get(), m_input_cache.get(), scores.data());
-  int retval = round(svm_predict(m_model.get(), m_input_cache.get()));
-#endif
-  return retval;
+void bob::learn::libsvm::Machine::countAllocations(size_t count) {
+  s_allocations.fetch_add(count, std::memory_order_relaxed);
 }
 
-int bob::learn::libsvm::Machine::predictClassAndScores
-(const blitz::Array<double,1>& input,
- blitz::Array<double,1>& scores) const {
+/**
+ * Returns a buffer private to the calling thread, with room for at least
+ * "size" entries. The buffer is kept between calls, so predictions issued
+ * from the same thread do not allocate memory once it has grown to the
+ * largest size seen. This is what makes the const prediction methods
+ * re-entrant: no scratch memory is shared between threads.
+ */
+template <typename T, scratch_t S> static T* thread_scratch(size_t size) {
+  static thread_local std::vector<T> scratch;
+  if (scratch.size() < size) {
+    scratch.resize(size);
+    bob::learn::libsvm::Machine::countAllocations();
+  }
+  return &scratch[0];
+}
 
-  if ((size_t)input.extent(0) < inputSize()) {
-    boost::format s("input for this SVM should have **at least** %d components, but you provided an array with %d elements instead");
-    s % inputSize() % input.extent(0);
-    throw std::runtime_error(s.str());
+/**
+ * Allocates memory for "size" elements, starting at a cache line boundary.
+ */
+template <typename T> static boost::shared_array<T> aligned_array(size_t size) {
+  void* retval = boost::alignment::aligned_alloc(CACHE_LINE,
+      std::max(size, (size_t)1)*sizeof(T));
+  if (!retval) throw std::bad_alloc();
+  return boost::shared_array<T>(static_cast<T*>(retval),
+      boost::alignment::aligned_free);
+}
+
+/**
+ * Computes the scale and offset mapping the values of every dimension of the
+ * support vectors, from their range to integer codes in [-qmax, qmax], so
+ * that value = offset + scale*code. Dimensions missing from sparse support
+ * vectors count as zeros. Entries outside of [1, size], which setDense()
+ * refuses, have no code and are ignored.
+ */
+static void quantization_range(const svm_model* model, size_t size,
+    double qmax, double* scale, double* offset) {
+
+  std::vector<double> lo(size, std::numeric_limits<double>::max());
+  std::vector<double> hi(size, -std::numeric_limits<double>::max());
+  std::vector<int> count(size, 0);
+  for (int k=0; k<model->l; ++k) {
+    for (const svm_node* it = model->SV[k]; it->index != -1; ++it) {
+      if (it->index < 1 || (size_t)it->index > size) continue;
+      const size_t i = it->index - 1;
+      lo[i] = std::min(lo[i], it->value);
+      hi[i] = std::max(hi[i], it->value);
+      ++count[i];
+    }
   }
 
-  if (!bob::core::array::isCContiguous(scores)) {
-    throw std::runtime_error("scores output array should be C-style contiguous and what you provided is not");
+  for (size_t i=0; i<size; ++i) {
+    if (count[i] < model->l) {
+      lo[i] = std::min(lo[i], 0.);
+      hi[i] = std::max(hi[i], 0.);
+    }
+    offset[i] = (lo[i] + hi[i]) / 2;
+    scale[i] = (hi[i] - lo[i]) / (2 * qmax);
   }
 
-  size_t N = outputSize();
-  size_t size = N < 2 ? 1 : (N*(N-1))/2;
-  if ((size_t)scores.extent(0) != size) {
-    boost::format s("output scores for this SVM (%d classes) should have %d components, but you provided an array with %d elements instead");
-    s % svm_get_nr_class(m_model.get()) % size % scores.extent(0);
+}
+
+/**
+ * Encodes the support vectors of a model, "size" codes per vector, and
+ * computes the squared norms of the decoded vectors. Entries are picked as by
+ * quantization_range().
+ */
+template <typename Q>
+static void quantize(const svm_model* model, size_t size,
+    const double* scale, const double* offset, Q* codes, double* norms) {
+
+  const double qmax = std::numeric_limits<Q>::max();
+  std::vector<double> row(size);
+  for (int k=0; k<model->l; ++k, codes+=size) {
+    std::fill(row.begin(), row.end(), 0.);
+    for (const svm_node* it = model->SV[k]; it->index != -1; ++it) {
+      if (it->index < 1 || (size_t)it->index > size) continue;
+      row[it->index-1] = it->value;
+    }
+    norms[k] = 0.;
+    for (size_t i=0; i<size; ++i) {
+      const double code = scale[i]? round((row[i] - offset[i]) / scale[i]) : 0.;
+      codes[i] = std::min(std::max(code, -qmax), qmax);
+      const double value = offset[i] + scale[i] * codes[i];
+      norms[k] += value * value;
+    }
+  }
+
+}
+
+void bob::learn::libsvm::Machine::setDense(bool dense) {
+
+  if (dense && kernelType() == PRECOMPUTED) {
+    throw std::runtime_error("SVMs with PRECOMPUTED kernels cannot be evaluated using dense support vectors");
+  }
+
+  restoreNodes();
+
+  if (dense && !one_based(m_model.get())) {
+    throw std::runtime_error("SVMs with support vector indices below 1 cannot be evaluated using dense support vectors");
+  }
+
+  m_sv.reset();
+  m_sv_q8.reset();
+  m_sv_q16.reset();
+  m_sv_scale.reset();
+  m_sv_offset.reset();
+
+  if (!dense) {
+    m_sv_coef.reset();
+    m_sv_norms.reset();
+    updatePrecision();
+    return;
+  }
+
+  //one row of coefficients per decision function a support vector is in
+  const size_t l = m_model->l;
+  const size_t n_coef = m_model->nr_class - 1;
+  m_sv_coef = aligned_array<double>(n_coef * l);
+  for (size_t k=0; k<n_coef; ++k) {
+    std::copy(m_model->sv_coef[k], m_model->sv_coef[k] + l,
+        m_sv_coef.get() + k * l);
+  }
+
+  //squared norms, so RBF kernels only need dot products with the input
+  m_sv_norms = aligned_array<double>(l);
+
+  if (m_bits) {
+    m_sv_scale = aligned_array<double>(m_input_size);
+    m_sv_offset = aligned_array<double>(m_input_size);
+    if (m_bits == 8) {
+      quantization_range(m_model.get(), m_input_size,
+          std::numeric_limits<int8_t>::max(), m_sv_scale.get(),
+          m_sv_offset.get());
+      m_sv_q8 = aligned_array<int8_t>(l * m_input_size);
+      quantize(m_model.get(), m_input_size, m_sv_scale.get(),
+          m_sv_offset.get(), m_sv_q8.get(), m_sv_norms.get());
+    }
+    else {
+      quantization_range(m_model.get(), m_input_size,
+          std::numeric_limits<int16_t>::max(), m_sv_scale.get(),
+          m_sv_offset.get());
+      m_sv_q16 = aligned_array<int16_t>(l * m_input_size);
+      quantize(m_model.get(), m_input_size, m_sv_scale.get(),
+          m_sv_offset.get(), m_sv_q16.get(), m_sv_norms.get());
+    }
+    releaseNodes();
+    updatePrecision();
+    return;
+  }
+
+  m_sv = aligned_array<double>(l * m_stride);
+  std::fill(m_sv.get(), m_sv.get() + l * m_stride, 0.);
+  for (size_t k=0; k<l; ++k) {
+    double* row = m_sv.get() + k * m_stride;
+    for (const svm_node* it = m_model->SV[k]; it->index != -1; ++it) {
+      row[it->index-1] = it->value;
+    }
+  }
+
+  for (size_t k=0; k<l; ++k) {
+    const double* row = m_sv.get() + k * m_stride;
+    dot(row, row, 0, 1, m_stride, &m_sv_norms[k]);
+  }
+
+  releaseNodes();
+  updatePrecision();
+}
+
+size_t bob::learn::libsvm::Machine::quantization() const {
+  if (m_sv_q8) return 8;
+  if (m_sv_q16) return 16;
+  return 0;
+}
+
+void bob::learn::libsvm::Machine::setQuantization(size_t bits) {
+
+  if (bits != 0 && bits != 8 && bits != 16) {
+    boost::format s("support vectors can only be quantized to 8 or 16 bits, not %d");
+    s % bits;
     throw std::runtime_error(s.str());
   }
 
-  return predictClassAndScores_(input, scores);
+  if (bits && !isDense()) {
+    throw std::runtime_error("only dense support vectors can be quantized");
+  }
+
+  m_bits = bits;
+  if (bits) m_compact = false; ///< keeps the exact support vectors
+  if (isDense()) setDense(true);
+
 }
 
-int bob::learn::libsvm::Machine::predictClassAndProbabilities_
-(const blitz::Array<double,1>& input,
- blitz::Array<double,1>& probabilities) const {
-  copy(input, m_input_size, m_input_cache, m_input_sub, m_input_div);
-  int retval = round(svm_predict_probability(m_model.get(), m_input_cache.get(), probabilities.data()));
+bool bob::learn::libsvm::Machine::releasable() const {
+  //libsvm computes the probabilities of other machines from the nodes
+  return isDense() && !isCollapsed() &&
+    (!supportsProbability() || computesProbability()) &&
+    (m_released || (m_owned && m_model->free_sv));
+}
+
+void bob::learn::libsvm::Machine::releaseNodes() {
+  if (!m_compact || m_released || !releasable()) return;
+  //libsvm's loader allocates all nodes in a single block, starting at SV[0]
+  if (m_model->l > 0) free(m_model->SV[0]);
+  std::fill(m_model->SV, m_model->SV + m_model->l, (svm_node*)0);
+  m_model->free_sv = 0;
+  m_released = true;
+}
+
+void bob::learn::libsvm::Machine::restoreNodes() {
+  if (!m_released) return;
+  buildNodes(m_model->SV);
+  m_model->free_sv = 1; ///< so svm_free_model_content() frees them
+  m_released = false;
+}
+
+void bob::learn::libsvm::Machine::buildNodes(svm_node** sv) const {
+
+  const size_t l = m_model->l;
+  if (!l) return;
+
+  //value of dimension i of support vector k
+  auto value = [&](size_t k, size_t i) -> double {
+    if (m_sv) return m_sv[k * m_stride + i];
+    const double code = m_sv_q8? m_sv_q8[k * m_input_size + i] :
+      m_sv_q16[k * m_input_size + i];
+    return m_sv_offset[i] + m_sv_scale[i] * code;
+  };
+
+  size_t nodes = l; ///< terminators
+  for (size_t k=0; k<l; ++k) {
+    for (size_t i=0; i<m_input_size; ++i) if (value(k, i) != 0.) ++nodes;
+  }
+
+  svm_node* space = static_cast<svm_node*>(malloc(nodes * sizeof(svm_node)));
+  if (!space) throw std::bad_alloc();
+
+  for (size_t k=0; k<l; ++k) {
+    sv[k] = space;
+    for (size_t i=0; i<m_input_size; ++i) {
+      const double v = value(k, i);
+      if (v == 0.) continue;
+      space->index = i + 1;
+      space->value = v;
+      ++space;
+    }
+    space->index = -1;
+    space->value = 0.;
+    ++space;
+  }
+
+}
+
+/**
+ * Frees a temporary copy of a model, made by Machine::nodeModel()
+ */
+static void node_model_free(svm_model* m) {
+  if (m->l > 0) free(m->SV[0]);
+  delete[] m->SV;
+  delete m;
+}
+
+boost::shared_ptr<svm_model> bob::learn::libsvm::Machine::nodeModel() const {
+  if (!m_released) return m_model;
+  //shares everything, but the nodes, with the model of this machine
+  boost::shared_ptr<svm_model> retval(new svm_model(*m_model),
+      node_model_free);
+  retval->SV = new svm_node*[std::max(m_model->l, 1)];
+  buildNodes(retval->SV);
+  retval->free_sv = 1;
   return retval;
 }
 
-int bob::learn::libsvm::Machine::predictClassAndProbabilities
-(const blitz::Array<double,1>& input,
- blitz::Array<double,1>& probabilities) const {
+void bob::learn::libsvm::Machine::setCompact(bool compact) {
 
-  if ((size_t)input.extent(0) < inputSize()) {
-    boost::format s("input for this SVM should have **at least** %d components, but you provided an array with %d elements instead");
-    s % inputSize() % input.extent(0);
-    throw std::runtime_error(s.str());
+  if (compact && !releasable()) {
+    throw std::runtime_error("the compact layout requires dense, not collapsed, support vectors owned by this machine, and that probabilities, if any, are computed by it");
   }
 
-  if (!supportsProbability()) {
-    throw std::runtime_error("this SVM does not support probabilities");
+  m_compact = compact;
+  if (compact) releaseNodes();
+  else restoreNodes();
+
+}
+
+/**
+ * Returns the number of decision functions of a model
+ */
+static inline int decision_functions(const svm_model* model) {
+  const int svm_type = model->param.svm_type;
+  if (svm_type == ONE_CLASS || svm_type == EPSILON_SVR ||
+      svm_type == NU_SVR) return 1;
+  return model->nr_class * (model->nr_class - 1) / 2;
+}
+
+/**
+ * Adds "coef" times the support vectors [start, start+size) to "w". Entries
+ * below index 1 are skipped: inputs start at index 1, so libsvm's dot product
+ * never matches them.
+ */
+static void accumulate(const svm_model* model, int start, int size,
+    const double* coef, double* w) {
+  for (int k=start; k<start+size; ++k) {
+    for (const svm_node* it = model->SV[k]; it->index != -1; ++it) {
+      if (it->index < 1) continue;
+      w[it->index-1] += coef[k] * it->value;
+    }
   }
+}
 
-  if (!bob::core::array::isCContiguous(probabilities)) {
-    throw std::runtime_error("probabilities output array should be C-style contiguous and what you provided is not");
+/**
+ * Computes the weight vectors of a LINEAR model, one row per decision
+ * function, "stride" elements apart.
+ */
+static void collapse(const svm_model* model, size_t stride, double* w) {
+  const int svm_type = model->param.svm_type;
+  std::fill(w, w + decision_functions(model) * stride, 0.);
+
+  if (svm_type == ONE_CLASS || svm_type == EPSILON_SVR ||
+      svm_type == NU_SVR) {
+    accumulate(model, 0, model->l, model->sv_coef[0], w);
+    return;
   }
 
-  if ((size_t)probabilities.extent(0) != outputSize()) {
-    boost::format s("output probabilities for this SVM should have %d components, but you provided an array with %d elements instead");
-    s % outputSize() % probabilities.extent(0);
-    throw std::runtime_error(s.str());
+  //same pairing of coefficients as in svm_predict_values()
+  const int nr_class = model->nr_class;
+  const int* n_sv = model->nSV;
+  for (int i=0, si=0, p=0; i<nr_class; si+=n_sv[i], ++i) {
+    for (int j=i+1, sj=si+n_sv[i]; j<nr_class; sj+=n_sv[j], ++j, ++p) {
+      accumulate(model, si, n_sv[i], model->sv_coef[j-1], w + p * stride);
+      accumulate(model, sj, n_sv[j], model->sv_coef[i], w + p * stride);
+    }
+  }
+}
+
+void bob::learn::libsvm::Machine::setCollapsed(bool collapsed) {
+
+  if (!collapsed) {
+    m_weights.reset();
+    m_bias.reset();
+    releaseNodes();
+    updatePrecision();
+    return;
   }
 
-  return predictClassAndProbabilities_(input, probabilities);
+  if (kernelType() != LINEAR) {
+    throw std::runtime_error("only SVMs with LINEAR kernels can be collapsed into weight vectors");
+  }
+
+  //weights are computed from the nodes, also when the input scaling changes
+  restoreNodes();
+  const int n_dec = decision_functions(m_model.get());
+  m_weights = aligned_array<double>(n_dec * m_stride);
+  m_bias = aligned_array<double>(n_dec);
+  updateScaling();
+
 }
 
-void bob::learn::libsvm::Machine::save(const std::string& filename) const {
-  if (svm_save_model(filename.c_str(), m_model.get())) {
-    boost::format s("cannot save SVM model to file '%s'");
-    s % filename;
-    throw std::runtime_error(s.str());
+void bob::learn::libsvm::Machine::updateScaling() {
+
+  m_input_mul.resize(m_input_div.extent(0));
+  m_input_scaled = false;
+  for (int k=0; k<m_input_div.extent(0); ++k) {
+    m_input_mul(k) = 1. / m_input_div(k);
+    if ((size_t)k < m_input_size &&
+        (m_input_sub(k) != 0. || m_input_div(k) != 1.)) m_input_scaled = true;
+  }
+
+  if (!m_weights) return updatePrecision();
+
+  //with w.((x - sub)/div) - rho = (w/div).x - (rho + (w/div).sub), inputs
+  //are used as they are
+  collapse(m_model.get(), m_stride, m_weights.get());
+  const int n_dec = decision_functions(m_model.get());
+  for (int p=0; p<n_dec; ++p) {
+    double* w = m_weights.get() + p * m_stride;
+    double bias = m_model->rho[p];
+    for (size_t k=0; k<m_input_size; ++k) {
+      w[k] *= m_input_mul(k);
+      bias += w[k] * m_input_sub(k);
+    }
+    m_bias[p] = bias;
+  }
+
+  updatePrecision();
+}
+
+void bob::learn::libsvm::Machine::updatePrecision() {
+
+  m_sv_f.reset();
+  m_sv_coef_f.reset();
+  m_sv_norms_f.reset();
+  m_weights_f.reset();
+  if (!m_single) return;
+
+  if (isDense()) {
+    const size_t l = m_model->l;
+    const size_t n_coef = m_model->nr_class - 1;
+    m_sv_coef_f = aligned_array<float>(n_coef * l);
+    std::copy(m_sv_coef.get(), m_sv_coef.get() + n_coef * l,
+        m_sv_coef_f.get());
+    m_sv_norms_f = aligned_array<float>(l);
+  }
+
+  if (isQuantized()) { //codes are decoded to float exactly
+    std::copy(m_sv_norms.get(), m_sv_norms.get() + m_model->l,
+        m_sv_norms_f.get());
+  }
+
+  if (m_sv) {
+    const size_t l = m_model->l;
+    m_sv_f = aligned_array<float>(l * m_fstride);
+    std::fill(m_sv_f.get(), m_sv_f.get() + l * m_fstride, 0.f);
+    for (size_t k=0; k<l; ++k) {
+      std::copy(m_sv.get() + k * m_stride,
+          m_sv.get() + k * m_stride + m_input_size,
+          m_sv_f.get() + k * m_fstride);
+    }
+
+    //from the rounded vectors, so distances to themselves remain zero
+    for (size_t k=0; k<l; ++k) {
+      const float* row = m_sv_f.get() + k * m_fstride;
+      dot(row, row, 0, 1, m_fstride, &m_sv_norms_f[k]);
+    }
+  }
+
+  if (m_weights) {
+    const int n_dec = decision_functions(m_model.get());
+    m_weights_f = aligned_array<float>(n_dec * m_fstride);
+    std::fill(m_weights_f.get(), m_weights_f.get() + n_dec * m_fstride, 0.f);
+    for (int p=0; p<n_dec; ++p) {
+      std::copy(m_weights.get() + p * m_stride,
+          m_weights.get() + p * m_stride + m_input_size,
+          m_weights_f.get() + p * m_fstride);
+    }
+  }
+
+}
+
+void bob::learn::libsvm::Machine::setSinglePrecision(bool single) {
+
+  if (single && !isDense() && !isCollapsed()) {
+    throw std::runtime_error("single precision inference is only available for SVMs evaluated with dense support vectors or collapsed weight vectors");
+  }
+
+  m_single = single;
+  updatePrecision();
+
+}
+
+blitz::Array<double,2> bob::learn::libsvm::Machine::getWeights() const {
+
+  if (kernelType() != LINEAR) {
+    throw std::runtime_error("weight vectors are only available for SVMs with LINEAR kernels");
   }
+
+  const int n_dec = decision_functions(m_model.get());
+  //m_weights has the input scaling folded in, so is not used here
+  boost::shared_array<double> weights = aligned_array<double>(n_dec * m_stride);
+  collapse(nodeModel().get(), m_stride, weights.get());
+
+  blitz::Array<double,2> retval(n_dec, m_input_size);
+  for (int p=0; p<n_dec; ++p) {
+    for (size_t k=0; k<m_input_size; ++k) {
+      retval(p,k) = weights[p * m_stride + k];
+    }
+  }
+  return retval;
+
+}
+
+/**
+ * Integer power, computed exactly as libsvm does
+ */
+static inline double powi(double base, int times) {
+  double tmp = base, ret = 1.0;
+  for (int t=times; t>0; t/=2) {
+    if (t%2==1) ret*=tmp;
+    tmp = tmp * tmp;
+  }
+  return ret;
+}
+
+/**
+ * Dense support vectors of a model, with their coefficients and squared
+ * norms, in the precision "T" predictions run in. Rows of support vectors
+ * are "stride" elements apart. Quantized support vectors are given by their
+ * codes instead, "size" per row, with the scale and offset of each
+ * dimension.
+ */
+template <typename T> struct dense_model {
+  const T* sv;
+  const int8_t* sv_q8;
+  const int16_t* sv_q16;
+  const double* scale;
+  const double* offset;
+  const T* sv_coef;
+  const T* sv_norms;
+  size_t stride;
+  size_t size;
+};
+
+/**
+ * Number of quantized support vectors decoded at once
+ */
+static const size_t DECODED_ROWS = 64;
+
+/**
+ * Decodes "rows" support vectors of "size" codes to rows of "output",
+ * "stride" elements apart and padded with zeros
+ */
+template <typename Q, typename T>
+static void decode(const Q* codes, size_t size, size_t rows, size_t stride,
+    T* output) {
+  for (size_t r=0; r<rows; ++r, codes+=size, output+=stride) {
+    std::copy(codes, codes + size, output);
+    std::fill(output + size, output + stride, T(0));
+  }
+}
+
+/**
+ * Computes the dot products between each of the "rows" scaled inputs in "x"
+ * and every quantized support vector: x.sv = x.offset + (scale*x).code, so
+ * inputs are multiplied by the scales once, then the products with the
+ * codes are computed by tiles of decoded support vectors.
+ */
+template <typename T>
+static void quantized_products(const svm_model* model,
+    const dense_model<T>& m, const T* x, size_t rows, T* kvalue) {
+
+  const size_t l = model->l;
+  T* scaled = thread_scratch<T,SCALED>(rows * m.stride);
+  double* offsets = thread_scratch<double,OFFSETS>(rows);
+  for (size_t r=0; r<rows; ++r) {
+    const T* row = x + r * m.stride;
+    T* scaled_row = scaled + r * m.stride;
+    offsets[r] = 0.;
+    for (size_t i=0; i<m.size; ++i) {
+      scaled_row[i] = m.scale[i] * row[i];
+      offsets[r] += m.offset[i] * row[i];
+    }
+    std::fill(scaled_row + m.size, scaled_row + m.stride, T(0));
+  }
+
+  T* decoded = thread_scratch<T,DECODED>(DECODED_ROWS * m.stride);
+  for (size_t t=0; t<l; t+=DECODED_ROWS) {
+    const size_t n = std::min(DECODED_ROWS, l - t);
+    if (m.sv_q8) decode(m.sv_q8 + t * m.size, m.size, n, m.stride, decoded);
+    else decode(m.sv_q16 + t * m.size, m.size, n, m.stride, decoded);
+    bob::learn::libsvm::dot(scaled, m.stride, rows, decoded, m.stride, n,
+        m.stride, kvalue + t, l);
+  }
+
+  for (size_t r=0; r<rows; ++r) {
+    for (size_t i=0; i<l; ++i) kvalue[r * l + i] += offsets[r];
+  }
+
+}
+
+/**
+ * RBF distances are computed as |x|^2 + |sv|^2 - 2 x.sv, with an absolute
+ * error proportional to |x|^2 + |sv|^2. Distances smaller than this fraction
+ * of the sum of the norms are summed again, term by term, as libsvm does: the
+ * relative error of any distance then stays within about 16 * size * 2^-53.
+ */
+static const double RBF_DIRECT = 1. / 16;
+
+/**
+ * Returns the squared distance between the scaled input "x" and support
+ * vector "k", summed term by term in double precision
+ */
+template <typename T>
+static double squared_distance(const dense_model<T>& m, const T* x,
+    size_t k) {
+  double retval = 0.;
+  for (size_t i=0; i<m.size; ++i) {
+    double sv;
+    if (m.sv) sv = m.sv[k * m.stride + i];
+    else if (m.sv_q8) sv = m.offset[i] + m.scale[i] * m.sv_q8[k * m.size + i];
+    else sv = m.offset[i] + m.scale[i] * m.sv_q16[k * m.size + i];
+    const double diff = x[i] - sv;
+    retval += diff * diff;
+  }
+  return retval;
+}
+
+/**
+ * Evaluates the kernel between each of the "rows" scaled inputs in "x" and
+ * every support vector. "x" is padded with zeros up to the row stride, so
+ * the vectorized primitives can run over whole rows without a scalar tail.
+ * Kernel functions are applied in double precision.
+ */
+template <typename T>
+static void kernel_block(const svm_model* model, const dense_model<T>& m,
+    const T* x, size_t rows, T* kvalue) {
+
+  const svm_parameter& param = model->param;
+  const size_t l = model->l;
+  if (m.sv) bob::learn::libsvm::dot(x, m.stride, rows, m.sv, m.stride, l,
+      m.stride, kvalue, l);
+  else quantized_products(model, m, x, rows, kvalue);
+
+  const size_t n = rows * l;
+  switch (param.kernel_type) {
+    case LINEAR:
+      break;
+    case POLY:
+      for (size_t i=0; i<n; ++i)
+        kvalue[i] = powi(param.gamma*kvalue[i]+param.coef0, param.degree);
+      break;
+    case RBF:
+      for (size_t r=0; r<rows; ++r, x+=m.stride, kvalue+=l) {
+        T x_norm;
+        bob::learn::libsvm::dot(x, x, 0, 1, m.stride, &x_norm);
+        for (size_t i=0; i<l; ++i) {
+          //the norms cancel out for inputs close to the support vector
+          const double norms = (double)x_norm + m.sv_norms[i];
+          double d = norms - 2.*kvalue[i];
+          if (d < RBF_DIRECT * norms) d = squared_distance(m, x, i);
+          kvalue[i] = exp(-param.gamma*d);
+        }
+      }
+      break;
+    case SIGMOID:
+      for (size_t i=0; i<n; ++i)
+        kvalue[i] = tanh(param.gamma*kvalue[i]+param.coef0);
+      break;
+    default:
+      throw std::runtime_error("kernel type is not supported by the dense evaluator");
+  }
+
+}
+
+/**
+ * Computes the decision values of an input from its kernel values
+ */
+template <typename T>
+static void decision_values(const svm_model* model, const dense_model<T>& m,
+    const T* kvalue, double* dec_values) {
+
+  const int svm_type = model->param.svm_type;
+  const int l = model->l;
+
+  if (svm_type == ONE_CLASS || svm_type == EPSILON_SVR ||
+      svm_type == NU_SVR) {
+    T sum;
+    bob::learn::libsvm::dot(m.sv_coef, kvalue, 0, 1, l, &sum);
+    *dec_values = sum - model->rho[0];
+    return;
+  }
+
+  //support vectors of class c take part in the nr_class-1 decision
+  //functions involving c, with one row of coefficients for each: the kernel
+  //values of every class block are multiplied once by all of these rows
+  const int nr_class = model->nr_class;
+  const int* n_sv = model->nSV;
+  const int n_coef = nr_class - 1;
+  T* partial = thread_scratch<T,PARTIAL>(nr_class * n_coef);
+  for (int c=0, sc=0; c<nr_class; sc+=n_sv[c], ++c) {
+    bob::learn::libsvm::dot(kvalue + sc, m.sv_coef + sc, l, n_coef,
+        n_sv[c], partial + c * n_coef);
+  }
+
+  //as in svm_predict_values(), the decision function between classes i
+  //and j uses coefficients j-1 for class i and coefficients i for class j
+  for (int i=0, p=0; i<nr_class; ++i) {
+    for (int j=i+1; j<nr_class; ++j, ++p) {
+      dec_values[p] = (double)partial[i * n_coef + j-1] +
+        partial[j * n_coef + i] - model->rho[p];
+    }
+  }
+
+}
+
+/**
+ * Scales the inputs into thread scratch memory, then evaluates their
+ * kernels, returned in thread scratch memory as well
+ */
+template <typename T, typename I>
+static const T* kernel_rows(const svm_model* model, const dense_model<T>& m,
+    const I* input, ptrdiff_t row_stride, ptrdiff_t stride, size_t rows,
+    size_t input_size, const double* sub, const double* mul) {
+
+  T* x = thread_scratch<T,INPUT>(rows * m.stride);
+  for (size_t r=0; r<rows; ++r) {
+    T* row = x + r * m.stride;
+    copy(input + r * row_stride, stride, input_size, row, sub, mul);
+    std::fill(row + input_size, row + m.stride, T(0));
+  }
+
+  T* kvalue = thread_scratch<T,KERNEL>(rows * model->l);
+  kernel_block(model, m, x, rows, kvalue);
+  return kvalue;
+
+}
+
+/**
+ * Evaluates the kernels and decision values of "rows" inputs
+ */
+template <typename T, typename I>
+static void decide_block(const svm_model* model, const dense_model<T>& m,
+    const I* input, ptrdiff_t row_stride, ptrdiff_t stride, size_t rows,
+    size_t input_size, const double* sub, const double* mul,
+    double* dec_values) {
+
+  const size_t l = model->l;
+  const T* kvalue = kernel_rows(model, m, input, row_stride, stride, rows,
+      input_size, sub, mul);
+
+  const size_t n_dec = std::max(decision_functions(model), 1);
+  for (size_t r=0; r<rows; ++r) {
+    decision_values(model, m, kvalue + r * l, dec_values + r * n_dec);
+  }
+
+}
+
+template <typename I>
+void bob::learn::libsvm::Machine::decideBlock(const I* input,
+    ptrdiff_t row_stride, ptrdiff_t stride, size_t rows,
+    double* dec_values) const {
+
+  const double* sub = m_input_scaled? m_input_sub.data() : 0;
+  if (m_single) {
+    const dense_model<float> m = {m_sv_f.get(), m_sv_q8.get(),
+      m_sv_q16.get(), m_sv_scale.get(), m_sv_offset.get(), m_sv_coef_f.get(),
+      m_sv_norms_f.get(), m_fstride, m_input_size};
+    decide_block(m_model.get(), m, input, row_stride, stride, rows,
+        m_input_size, sub, m_input_mul.data(), dec_values);
+  }
+  else {
+    const dense_model<double> m = {m_sv.get(), m_sv_q8.get(),
+      m_sv_q16.get(), m_sv_scale.get(), m_sv_offset.get(), m_sv_coef.get(),
+      m_sv_norms.get(), m_stride, m_input_size};
+    decide_block(m_model.get(), m, input, row_stride, stride, rows,
+        m_input_size, sub, m_input_mul.data(), dec_values);
+  }
+
+}
+
+/**
+ * Returns the input as contiguous elements of type "T", copying it into
+ * thread scratch memory unless it can be used as it is
+ */
+template <typename T, typename I>
+static const T* contiguous(const I* input, ptrdiff_t stride, size_t size) {
+  if (stride == 1 && std::is_same<T,I>::value) {
+    return reinterpret_cast<const T*>(input);
+  }
+  T* retval = thread_scratch<T,INPUT>(size);
+  copy(input, stride, size, retval, 0, 0);
+  return retval;
+}
+
+/**
+ * Decision values of collapsed models: one dot product per decision
+ * function, with the input scaling folded into "weights" and "bias"
+ */
+template <typename T, typename I>
+static void collapsed_values(const I* input, ptrdiff_t stride,
+    size_t size, const T* weights, size_t w_stride, int n_dec,
+    const double* bias, double* dec_values) {
+  const T* x = contiguous<T>(input, stride, size);
+  T* products = thread_scratch<T,PRODUCTS>(n_dec);
+  bob::learn::libsvm::dot(x, weights, w_stride, n_dec, size, products);
+  for (int p=0; p<n_dec; ++p) dec_values[p] = products[p] - bias[p];
+}
+
+/**
+ * One-vs-one voting between "nr_class" classes, evaluating the decision
+ * function between classes i < j, number p in the order of
+ * svm_predict_values(), on demand through "decision(i, j, p)". A first
+ * candidate is found by letting the winner of each decision function face
+ * the next class. Then all pending decision functions of the candidate are
+ * evaluated, and of the class that could still get the most votes next,
+ * until no class can catch up with the leader. Returns the index of the
+ * class with most votes, ties going to the lowest index, as with a full
+ * vote.
+ */
+template <typename F>
+static int early_vote(int nr_class, const F& decision) {
+
+  int* vote = thread_scratch<int,VOTES>(2 * nr_class);
+  int* pending = vote + nr_class;
+  std::fill(vote, vote + nr_class, 0);
+  std::fill(pending, pending + nr_class, nr_class - 1);
+  const int n_dec = nr_class * (nr_class - 1) / 2;
+  char* evaluated = thread_scratch<char,EVALUATED>(n_dec);
+  std::fill(evaluated, evaluated + n_dec, 0);
+
+  //evaluates the decision function between a and b if still pending,
+  //returns the winner
+  auto play = [&](int a, int b) {
+    const int i = std::min(a, b);
+    const int j = std::max(a, b);
+    const int p = i * (2 * nr_class - i - 1) / 2 + j - i - 1;
+    if (evaluated[p]) return -1;
+    evaluated[p] = 1;
+    --pending[i];
+    --pending[j];
+    const int winner = (decision(i, j, p) > 0)? i : j;
+    ++vote[winner];
+    return winner;
+  };
+
+  int candidate = 0;
+  for (int c=1; c<nr_class; ++c) candidate = play(candidate, c);
+
+  for (;;) {
+    for (int c=0; c<nr_class; ++c) if (c != candidate) play(candidate, c);
+
+    //the leader wins if no other class can get more votes, or as many with
+    //a lower index
+    int leader = 0;
+    for (int k=1; k<nr_class; ++k) if (vote[k] > vote[leader]) leader = k;
+    bool decided = true;
+    for (int k=0; k<nr_class && decided; ++k) {
+      const int most = vote[k] + pending[k];
+      decided = k == leader || most < vote[leader] ||
+        (most == vote[leader] && k > leader);
+    }
+    if (decided) return leader;
+
+    //with no pending decision functions, the leader is decided, so there
+    //is a candidate left here
+    candidate = -1;
+    for (int k=0; k<nr_class; ++k) {
+      if (pending[k] && (candidate < 0 ||
+            vote[k] + pending[k] > vote[candidate] + pending[candidate]))
+        candidate = k;
+    }
+  }
+
+}
+
+bool bob::learn::libsvm::Machine::votesEarly() const {
+  const int svm_type = m_model->param.svm_type;
+  return m_early && (svm_type == C_SVC || svm_type == NU_SVC) &&
+    m_model->nr_class > 2 && (isDense() || isCollapsed());
+}
+
+/**
+ * Predicts the class index of an input of a collapsed model with early
+ * voting, computing the decision values as collapsed_values() does
+ */
+template <typename T, typename I>
+static int collapsed_vote(const svm_model* model, const I* input,
+    ptrdiff_t stride, size_t size, const T* weights, size_t w_stride,
+    const double* bias) {
+  const T* x = contiguous<T>(input, stride, size);
+  return early_vote(model->nr_class, [&](int, int, int p) {
+    T product;
+    bob::learn::libsvm::dot(x, weights + p * w_stride, 0, 1, size, &product);
+    return product - bias[p];
+  });
+}
+
+/**
+ * Predicts the class indexes of "rows" inputs with early voting, computing
+ * the decision values as decision_values() does
+ */
+template <typename T, typename I>
+static void classify_block(const svm_model* model, const dense_model<T>& m,
+    const I* input, ptrdiff_t row_stride, ptrdiff_t stride, size_t rows,
+    size_t input_size, const double* sub, const double* mul,
+    double* labels) {
+
+  const int l = model->l;
+  const int nr_class = model->nr_class;
+  const int* n_sv = model->nSV;
+  int* start = thread_scratch<int,STARTS>(nr_class);
+  for (int c=0, sc=0; c<nr_class; sc+=n_sv[c], ++c) start[c] = sc;
+
+  const T* kvalue = kernel_rows(model, m, input, row_stride, stride, rows,
+      input_size, sub, mul);
+  for (size_t r=0; r<rows; ++r, kvalue+=l) {
+    const int winner = early_vote(nr_class, [&](int i, int j, int p) {
+      T coef_i, coef_j;
+      bob::learn::libsvm::dot(kvalue + start[i],
+          m.sv_coef + (j-1) * l + start[i], 0, 1, n_sv[i], &coef_i);
+      bob::learn::libsvm::dot(kvalue + start[j],
+          m.sv_coef + i * l + start[j], 0, 1, n_sv[j], &coef_j);
+      return (double)coef_i + coef_j - model->rho[p];
+    });
+    labels[r] = model->label[winner];
+  }
+
+}
+
+template <typename I>
+void bob::learn::libsvm::Machine::classifyBlock(const I* input,
+    ptrdiff_t row_stride, ptrdiff_t stride, size_t rows,
+    double* labels) const {
+
+  if (m_weights) {
+    for (size_t r=0; r<rows; ++r) {
+      const I* row = input + r * row_stride;
+      const int winner = m_weights_f?
+        collapsed_vote(m_model.get(), row, stride, m_input_size,
+            m_weights_f.get(), m_fstride, m_bias.get()) :
+        collapsed_vote(m_model.get(), row, stride, m_input_size,
+            m_weights.get(), m_stride, m_bias.get());
+      labels[r] = m_model->label[winner];
+    }
+    return;
+  }
+
+  const double* sub = m_input_scaled? m_input_sub.data() : 0;
+  if (m_single) {
+    const dense_model<float> m = {m_sv_f.get(), m_sv_q8.get(),
+      m_sv_q16.get(), m_sv_scale.get(), m_sv_offset.get(), m_sv_coef_f.get(),
+      m_sv_norms_f.get(), m_fstride, m_input_size};
+    classify_block(m_model.get(), m, input, row_stride, stride, rows,
+        m_input_size, sub, m_input_mul.data(), labels);
+  }
+  else {
+    const dense_model<double> m = {m_sv.get(), m_sv_q8.get(),
+      m_sv_q16.get(), m_sv_scale.get(), m_sv_offset.get(), m_sv_coef.get(),
+      m_sv_norms.get(), m_stride, m_input_size};
+    classify_block(m_model.get(), m, input, row_stride, stride, rows,
+        m_input_size, sub, m_input_mul.data(), labels);
+  }
+
+}
+
+double bob::learn::libsvm::Machine::vote(const double* dec_values) const {
+
+  const int svm_type = m_model->param.svm_type;
+  if (svm_type == ONE_CLASS) return (*dec_values>0)? 1 : -1;
+  if (svm_type == EPSILON_SVR || svm_type == NU_SVR) return *dec_values;
+
+  const int nr_class = m_model->nr_class;
+  int* vote = thread_scratch<int,VOTES>(nr_class);
+  std::fill(vote, vote + nr_class, 0);
+  for (int i=0, p=0; i<nr_class; ++i) {
+    for (int j=i+1; j<nr_class; ++j, ++p) {
+      if (dec_values[p] > 0) ++vote[i];
+      else ++vote[j];
+    }
+  }
+
+  int vote_max_idx = 0;
+  for (int i=1; i<nr_class; ++i)
+    if (vote[i] > vote[vote_max_idx]) vote_max_idx = i;
+
+  return m_model->label[vote_max_idx];
+}
+
+/**
+ * Lets libsvm evaluate an input already converted to nodes. libsvm allocates
+ * its own working memory on every call, which is counted as one allocation.
+ */
+static double libsvm_values(svm_model* model, const svm_node* nodes,
+    double* dec_values) {
+  bob::learn::libsvm::Machine::countAllocations();
+#if LIBSVM_VERSION > 290
+  return svm_predict_values(model, nodes, dec_values);
+#else
+  svm_predict_values(model, nodes, dec_values);
+  return svm_predict(model, nodes);
+#endif
+}
+
+/**
+ * Scales the input into libsvm nodes and lets libsvm evaluate it
+ */
+template <typename I>
+static double libsvm_values(svm_model* model, const I* input,
+    ptrdiff_t stride, size_t size, const double* sub, const double* mul,
+    double* dec_values) {
+  svm_node* cache = thread_scratch<svm_node,NODES>(size + 1);
+  copy(input, stride, size, cache, sub, mul);
+  return libsvm_values(model, cache, dec_values);
+}
+
+template <typename I>
+double bob::learn::libsvm::Machine::predictValues(const I* input,
+    ptrdiff_t stride, double* dec_values) const {
+
+  if (!isDense() && !isCollapsed()) { //let libsvm do the job
+    return libsvm_values(m_model.get(), input, stride, m_input_size,
+        m_input_scaled? m_input_sub.data() : 0, m_input_mul.data(),
+        dec_values);
+  }
+
+  if (m_weights) {
+    const int n_dec = decision_functions(m_model.get());
+    if (m_weights_f) collapsed_values(input, stride, m_input_size,
+        m_weights_f.get(), m_fstride, n_dec, m_bias.get(), dec_values);
+    else collapsed_values(input, stride, m_input_size, m_weights.get(),
+        m_stride, n_dec, m_bias.get(), dec_values);
+    return vote(dec_values);
+  }
+
+  decideBlock(input, 0, stride, 1, dec_values);
+  return vote(dec_values);
+}
+
+template <typename I>
+double bob::learn::libsvm::Machine::predict(const I* input,
+    ptrdiff_t stride) const {
+  if (votesEarly()) {
+    double label;
+    classifyBlock(input, 0, stride, 1, &label);
+    return label;
+  }
+  double* dec_values = thread_scratch<double,DECISION>(
+      std::max(decision_functions(m_model.get()), 1));
+  return predictValues(input, stride, dec_values);
+}
+
+/**
+ * Sigmoid mapping of decision values into probabilities, as in libsvm
+ */
+static inline double sigmoid_predict(double decision_value, double A,
+    double B) {
+  double fApB = decision_value*A+B;
+  //1-p used later; avoid catastrophic cancellation
+  if (fApB >= 0) return exp(-fApB)/(1.0+exp(-fApB));
+  else return 1.0/(1+exp(fApB));
+}
+
+/**
+ * Method 2 from the multi-class probability paper by Wu, Lin, and Weng, as
+ * implemented in libsvm. "r" holds the k x k pair-wise probabilities, the
+ * result is written in "p".
+ */
+static void multiclass_probability(int k, const double* r, double* p) {
+
+  const int max_iter = std::max(100, k);
+  double* Q = thread_scratch<double,QMATRIX>(k*k + k);
+  double* Qp = Q + k*k;
+  const double eps = 0.005/k;
+
+  for (int t=0; t<k; ++t) {
+    p[t] = 1.0/k; //valid if k = 1
+    Q[t*k+t] = 0;
+    for (int j=0; j<t; ++j) {
+      Q[t*k+t] += r[j*k+t]*r[j*k+t];
+      Q[t*k+j] = Q[j*k+t];
+    }
+    for (int j=t+1; j<k; ++j) {
+      Q[t*k+t] += r[j*k+t]*r[j*k+t];
+      Q[t*k+j] = -r[j*k+t]*r[t*k+j];
+    }
+  }
+
+  for (int iter=0; iter<max_iter; ++iter) {
+    //stopping condition, recalculate QP,pQP for numerical accuracy
+    double pQp = 0;
+    for (int t=0; t<k; ++t) {
+      Qp[t] = 0;
+      for (int j=0; j<k; ++j) Qp[t] += Q[t*k+j]*p[j];
+      pQp += p[t]*Qp[t];
+    }
+    double max_error = 0;
+    for (int t=0; t<k; ++t) {
+      double error = fabs(Qp[t]-pQp);
+      if (error > max_error) max_error = error;
+    }
+    if (max_error < eps) break;
+
+    for (int t=0; t<k; ++t) {
+      double diff = (-Qp[t]+pQp)/Q[t*k+t];
+      p[t] += diff;
+      pQp = (pQp+diff*(diff*Q[t*k+t]+2*Qp[t]))/(1+diff)/(1+diff);
+      for (int j=0; j<k; ++j) {
+        Qp[j] = (Qp[j]+diff*Q[t*k+j])/(1+diff);
+        p[j] /= (1+diff);
+      }
+    }
+  }
+
+}
+
+bool bob::learn::libsvm::Machine::computesProbability() const {
+  const int svm_type = m_model->param.svm_type;
+  return (isDense() || isCollapsed()) && (svm_type == C_SVC || svm_type == NU_SVC) &&
+    m_model->probA && m_model->probB;
+}
+
+double bob::learn::libsvm::Machine::probability(const double* dec_values,
+    double* prob_estimates) const {
+
+  //this is the same as libsvm's svm_predict_probability()
+  const int nr_class = m_model->nr_class;
+  const double min_prob = 1e-7;
+  double* pairwise_prob = thread_scratch<double,PAIRWISE>(nr_class*nr_class);
+  for (int i=0, k=0; i<nr_class; ++i) {
+    for (int j=i+1; j<nr_class; ++j, ++k) {
+      double prob = sigmoid_predict(dec_values[k], m_model->probA[k],
+          m_model->probB[k]);
+      pairwise_prob[i*nr_class+j] = std::min(std::max(prob, min_prob),
+          1-min_prob);
+      pairwise_prob[j*nr_class+i] = 1-pairwise_prob[i*nr_class+j];
+    }
+  }
+
+  if (nr_class == 2) {
+    prob_estimates[0] = pairwise_prob[1];
+    prob_estimates[1] = pairwise_prob[2];
+  }
+  else {
+    multiclass_probability(nr_class, pairwise_prob, prob_estimates);
+  }
+
+  int prob_max_idx = 0;
+  for (int i=1; i<nr_class; ++i)
+    if (prob_estimates[i] > prob_estimates[prob_max_idx]) prob_max_idx = i;
+
+  return m_model->label[prob_max_idx];
+}
+
+template <typename I>
+double bob::learn::libsvm::Machine::predictProbability(const I* input,
+    ptrdiff_t stride, double* prob_estimates) const {
+
+  if (!computesProbability()) { //let libsvm do the job
+    svm_node* cache = thread_scratch<svm_node,NODES>(m_input_size + 1);
+    copy(input, stride, m_input_size, cache,
+        m_input_scaled? m_input_sub.data() : 0, m_input_mul.data());
+    countAllocations(); ///< libsvm's own working memory
+    return svm_predict_probability(m_model.get(), cache, prob_estimates);
+  }
+
+  double* dec_values = thread_scratch<double,DECISION>(
+      decision_functions(m_model.get()));
+  predictValues(input, stride, dec_values);
+  return probability(dec_values, prob_estimates);
+}
+
+int bob::learn::libsvm::Machine::predictClass_
+(const blitz::Array<double,1>& input) const {
+  return round(predict(input.data(), input.stride(0)));
+}
+
+int bob::learn::libsvm::Machine::predictClass_
+(const blitz::Array<float,1>& input) const {
+  return round(predict(input.data(), input.stride(0)));
+}
+
+int bob::learn::libsvm::Machine::predictClass
+(const blitz::Array<double,1>& input) const {
+
+  if ((size_t)input.extent(0) < inputSize()) {
+    boost::format s("input for this SVM should have **at least** %d components, but you provided an array with %d elements instead");
+    s % inputSize() % input.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  return predictClass_(input);
+}
+
+int bob::learn::libsvm::Machine::predictClassAndScores_
+(const blitz::Array<double,1>& input,
+ blitz::Array<double,1>& scores) const {
+  return round(predictValues(input.data(), input.stride(0), scores.data()));
+}
+
+int bob::learn::libsvm::Machine::predictClassAndScores_
+(const blitz::Array<float,1>& input,
+ blitz::Array<double,1>& scores) const {
+  return round(predictValues(input.data(), input.stride(0), scores.data()));
+}
+
+int bob::learn::libsvm::Machine::predictClassAndScores
+(const blitz::Array<double,1>& input,
+ blitz::Array<double,1>& scores) const {
+
+  if ((size_t)input.extent(0) < inputSize()) {
+    boost::format s("input for this SVM should have **at least** %d components, but you provided an array with %d elements instead");
+    s % inputSize() % input.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  if (!bob::core::array::isCContiguous(scores)) {
+    throw std::runtime_error("scores output array should be C-style contiguous and what you provided is not");
+  }
+
+  size_t N = outputSize();
+  size_t size = N < 2 ? 1 : (N*(N-1))/2;
+  if ((size_t)scores.extent(0) != size) {
+    boost::format s("output scores for this SVM (%d classes) should have %d components, but you provided an array with %d elements instead");
+    s % svm_get_nr_class(m_model.get()) % size % scores.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  return predictClassAndScores_(input, scores);
+}
+
+int bob::learn::libsvm::Machine::predictClassAndProbabilities_
+(const blitz::Array<double,1>& input,
+ blitz::Array<double,1>& probabilities) const {
+  return round(predictProbability(input.data(), input.stride(0),
+        probabilities.data()));
+}
+
+int bob::learn::libsvm::Machine::predictClassAndProbabilities_
+(const blitz::Array<float,1>& input,
+ blitz::Array<double,1>& probabilities) const {
+  return round(predictProbability(input.data(), input.stride(0),
+        probabilities.data()));
+}
+
+int bob::learn::libsvm::Machine::predictClassAndProbabilities
+(const blitz::Array<double,1>& input,
+ blitz::Array<double,1>& probabilities) const {
+
+  if ((size_t)input.extent(0) < inputSize()) {
+    boost::format s("input for this SVM should have **at least** %d components, but you provided an array with %d elements instead");
+    s % inputSize() % input.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  if (!supportsProbability()) {
+    throw std::runtime_error("this SVM does not support probabilities");
+  }
+
+  if (!bob::core::array::isCContiguous(probabilities)) {
+    throw std::runtime_error("probabilities output array should be C-style contiguous and what you provided is not");
+  }
+
+  if ((size_t)probabilities.extent(0) != outputSize()) {
+    boost::format s("output probabilities for this SVM should have %d components, but you provided an array with %d elements instead");
+    s % outputSize() % probabilities.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  return predictClassAndProbabilities_(input, probabilities);
+}
+
+/**
+ * Minimum number of rows handed to each thread by the batch prediction
+ * methods. Smaller batches are not worth the cost of starting threads.
+ */
+static const size_t BATCH_GRAIN = 64;
+
+/**
+ * With dense support vectors, batches are evaluated in blocks of at most
+ * this many rows, or fewer, so that the kernel values of a block do not
+ * exceed BLOCK_KERNELS entries (2 MiB)
+ */
+static const size_t BLOCK_ROWS = 64;
+static const size_t BLOCK_KERNELS = 256 * 1024;
+
+void bob::learn::libsvm::Machine::setNumberOfThreads(size_t threads) {
+  m_threads = threads ? threads : boost::thread::hardware_concurrency();
+  if (!m_threads) m_threads = 1;
+}
+
+/**
+ * Checks the input matrix and the labels array of the batch prediction
+ * methods, raises if any of those is not correctly sized.
+ */
+static void check_batch(size_t input_size, const blitz::Array<double,2>& input,
+    const blitz::Array<int64_t,1>& labels) {
+
+  if ((size_t)input.extent(1) < input_size) {
+    boost::format s("input for this SVM should have **at least** %d columns, but you provided an array with %d columns instead");
+    s % input_size % input.extent(1);
+    throw std::runtime_error(s.str());
+  }
+
+  if (labels.extent(0) != input.extent(0)) {
+    boost::format s("output labels should have %d components matching the number of rows in the input, but you provided an array with %d elements instead");
+    s % input.extent(0) % labels.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+}
+
+template <typename I>
+void bob::learn::libsvm::Machine::forEachDecision
+(const blitz::Array<I,2>& input,
+ const boost::function<void (size_t, double, const double*)>& f,
+ bool values) const {
+
+  const size_t n_dec = std::max(decision_functions(m_model.get()), 1);
+  const size_t l = m_model->l;
+  const bool blocked = isDense() && !isCollapsed();
+  const size_t block = blocked? std::min(BLOCK_ROWS,
+      std::max((size_t)4, BLOCK_KERNELS / std::max(l, (size_t)1))) : 1;
+
+  //work is split in whole blocks, so that the rows evaluated together, and
+  //therefore the results, do not depend on the number of threads
+  const size_t size = input.extent(0);
+  const size_t blocks = (size + block - 1) / block;
+  auto body = [&](size_t first, size_t last) {
+
+    if (!values && votesEarly()) {
+      double* labels = thread_scratch<double,DECISION>(block);
+      for (size_t b=first*block; b<std::min(last*block, size); b+=block) {
+        const size_t rows = std::min(block, size - b);
+        classifyBlock(&input(b,0), input.stride(0), input.stride(1), rows,
+            labels);
+        for (size_t r=0; r<rows; ++r) f(b+r, labels[r], 0);
+      }
+      return;
+    }
+
+    if (!blocked) {
+      double* dec_values = thread_scratch<double,DECISION>(n_dec);
+      for (size_t k=first; k<last; ++k) {
+        f(k, predictValues(&input(k,0), input.stride(1), dec_values),
+            dec_values);
+      }
+      return;
+    }
+
+    for (size_t b=first*block; b<std::min(last*block, size); b+=block) {
+      const size_t rows = std::min(block, size - b);
+      double* dec_values = thread_scratch<double,DECISION>(rows * n_dec);
+      decideBlock(&input(b,0), input.stride(0), input.stride(1), rows,
+          dec_values);
+      for (size_t r=0; r<rows; ++r) {
+        f(b+r, vote(dec_values + r * n_dec), dec_values + r * n_dec);
+      }
+    }
+
+  };
+
+  bob::learn::libsvm::parallelFor(blocks, m_threads,
+      std::max(BATCH_GRAIN / block, (size_t)1), boost::cref(body));
+
+}
+
+size_t bob::learn::libsvm::Machine::quantizationError
+(const blitz::Array<double,2>& input, blitz::Array<double,1>& errors) const {
+
+  if (!isQuantized()) {
+    throw std::runtime_error("cannot measure quantization errors: support vectors are not quantized");
+  }
+
+  if (m_released) {
+    throw std::runtime_error("cannot measure quantization errors: the exact support vectors were released by the compact layout");
+  }
+
+  if ((size_t)input.extent(1) < inputSize()) {
+    boost::format s("input for this SVM should have **at least** %d columns, but you provided an array with %d columns instead");
+    s % inputSize() % input.extent(1);
+    throw std::runtime_error(s.str());
+  }
+
+  if (errors.extent(0) != input.extent(0)) {
+    boost::format s("output errors should have %d components matching the number of rows in the input, but you provided an array with %d elements instead");
+    s % input.extent(0) % errors.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  //outputs of regression machines are not labels, so are not compared
+  const int svm_type = m_model->param.svm_type;
+  const bool labels = svm_type != EPSILON_SVR && svm_type != NU_SVR;
+  const int n_dec = std::max(decision_functions(m_model.get()), 1);
+  std::vector<char> changed(input.extent(0), 0);
+  auto compare = [&](size_t k, double label, const double* dec_values) {
+    double* reference = thread_scratch<double,REFERENCE>(n_dec);
+    const double expected = libsvm_values(m_model.get(), &input(k,0),
+        input.stride(1), m_input_size,
+        m_input_scaled? m_input_sub.data() : 0, m_input_mul.data(),
+        reference);
+    double error = 0.;
+    for (int p=0; p<n_dec; ++p) {
+      error = std::max(error, fabs(dec_values[p] - reference[p]));
+    }
+    errors(k) = error;
+    changed[k] = labels && label != expected;
+  };
+  forEachDecision(input, boost::cref(compare));
+
+  return std::count(changed.begin(), changed.end(), 1);
+}
+
+template <typename I>
+void bob::learn::libsvm::Machine::predictBatch
+(const blitz::Array<I,2>& input, blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>* scores, blitz::Array<double,2>* probabilities)
+const {
+
+  //closures are passed by reference: copying them into boost::function
+  //would allocate memory on every call
+  if (probabilities && computesProbability()) {
+    auto store = [&](size_t k, double, const double* dec_values) {
+      labels(k) = round(probability(dec_values, &(*probabilities)(k,0)));
+    };
+    forEachDecision(input, boost::cref(store));
+    return;
+  }
+
+  if (probabilities) {
+    auto body = [&](size_t start, size_t end) {
+      for (size_t k=start; k<end; ++k) {
+        labels(k) = round(predictProbability(&input(k,0), input.stride(1),
+              &(*probabilities)(k,0)));
+      }
+    };
+    bob::learn::libsvm::parallelFor(input.extent(0), m_threads, BATCH_GRAIN,
+        boost::cref(body));
+    return;
+  }
+
+  auto store = [&](size_t k, double label, const double* dec_values) {
+    labels(k) = round(label);
+    if (scores) std::copy(dec_values, dec_values + scores->extent(1),
+        &(*scores)(k,0));
+  };
+  forEachDecision(input, boost::cref(store), scores != 0);
+
+}
+
+void bob::learn::libsvm::Machine::predictClassBatch_
+(const blitz::Array<double,2>& input, blitz::Array<int64_t,1>& labels) const {
+  predictBatch(input, labels, 0, 0);
+}
+
+void bob::learn::libsvm::Machine::predictClassBatch_
+(const blitz::Array<float,2>& input, blitz::Array<int64_t,1>& labels) const {
+  predictBatch(input, labels, 0, 0);
+}
+
+void bob::learn::libsvm::Machine::predictClassBatch
+(const blitz::Array<double,2>& input, blitz::Array<int64_t,1>& labels) const {
+  check_batch(inputSize(), input, labels);
+  predictClassBatch_(input, labels);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndScoresBatch_
+(const blitz::Array<double,2>& input, blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>& scores) const {
+  predictBatch(input, labels, &scores, 0);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndScoresBatch_
+(const blitz::Array<float,2>& input, blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>& scores) const {
+  predictBatch(input, labels, &scores, 0);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndScoresBatch
+(const blitz::Array<double,2>& input, blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>& scores) const {
+
+  check_batch(inputSize(), input, labels);
+
+  if (!bob::core::array::isCContiguous(scores)) {
+    throw std::runtime_error("scores output array should be C-style contiguous and what you provided is not");
+  }
+
+  size_t N = outputSize();
+  size_t size = N < 2 ? 1 : (N*(N-1))/2;
+  if (scores.extent(0) != input.extent(0) || (size_t)scores.extent(1) != size) {
+    boost::format s("output scores for this SVM (%d classes) should have shape (%d, %d), but you provided an array with shape (%d, %d) instead");
+    s % svm_get_nr_class(m_model.get()) % input.extent(0) % size % scores.extent(0) % scores.extent(1);
+    throw std::runtime_error(s.str());
+  }
+
+  predictClassAndScoresBatch_(input, labels, scores);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndProbabilitiesBatch_
+(const blitz::Array<double,2>& input, blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>& probabilities) const {
+  predictBatch(input, labels, 0, &probabilities);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndProbabilitiesBatch_
+(const blitz::Array<float,2>& input, blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>& probabilities) const {
+  predictBatch(input, labels, 0, &probabilities);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndProbabilitiesBatch
+(const blitz::Array<double,2>& input, blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>& probabilities) const {
+
+  check_batch(inputSize(), input, labels);
+
+  if (!supportsProbability()) {
+    throw std::runtime_error("this SVM does not support probabilities");
+  }
+
+  if (!bob::core::array::isCContiguous(probabilities)) {
+    throw std::runtime_error("probabilities output array should be C-style contiguous and what you provided is not");
+  }
+
+  if (probabilities.extent(0) != input.extent(0) ||
+      (size_t)probabilities.extent(1) != numberOfClasses()) {
+    boost::format s("output probabilities for this SVM should have shape (%d, %d), but you provided an array with shape (%d, %d) instead");
+    s % input.extent(0) % numberOfClasses() % probabilities.extent(0) % probabilities.extent(1);
+    throw std::runtime_error(s.str());
+  }
+
+  predictClassAndProbabilitiesBatch_(input, labels, probabilities);
+}
+
+double bob::learn::libsvm::Machine::predictSparse(const int64_t* index,
+    const double* value, size_t size, bool shifted, double* dec_values,
+    double* prob_estimates) const {
+
+  if (m_weights && (!prob_estimates || computesProbability())) {
+    //the input scaling is folded into the weights and biases
+    const int n_dec = decision_functions(m_model.get());
+    for (int p=0; p<n_dec; ++p) {
+      const double* w = m_weights.get() + p * m_stride;
+      double sum = 0.;
+      for (size_t k=0; k<size && (size_t)index[k]<m_input_size; ++k) {
+        sum += w[index[k]] * value[k];
+      }
+      dec_values[p] = sum - m_bias[p];
+    }
+    if (prob_estimates) return probability(dec_values, prob_estimates);
+    return vote(dec_values);
+  }
+
+  svm_node* nodes;
+  if (shifted) { //missing values are not zero once scaled
+    double* row = thread_scratch<double,SCATTERED>(m_input_size);
+    scatter(index, value, size, m_input_size, row);
+    nodes = thread_scratch<svm_node,NODES>(m_input_size + 1);
+    copy(row, 1, m_input_size, nodes, m_input_sub.data(),
+        m_input_mul.data());
+  }
+  else {
+    nodes = thread_scratch<svm_node,NODES>(size + 1);
+    copy_sparse(index, value, size, m_input_size, nodes,
+        m_input_scaled? m_input_mul.data() : 0);
+  }
+
+  if (prob_estimates) {
+    countAllocations(); ///< libsvm's own working memory
+    return svm_predict_probability(m_model.get(), nodes, prob_estimates);
+  }
+  return libsvm_values(m_model.get(), nodes, dec_values);
+
+}
+
+void bob::learn::libsvm::Machine::predictSparseBatch
+(const blitz::Array<int64_t,1>& indptr,
+ const blitz::Array<int64_t,1>& indices, const blitz::Array<double,1>& values,
+ blitz::Array<int64_t,1>& labels, blitz::Array<double,2>* scores,
+ blitz::Array<double,2>* probabilities) const {
+
+  const int64_t* ptr = indptr.data();
+  const int64_t* index = indices.data();
+  const double* value = values.data();
+
+  bool shifted = false;
+  for (size_t k=0; k<m_input_size; ++k) shifted |= m_input_sub(k) != 0.;
+
+  //probabilities libsvm computes need its own evaluator
+  const bool blocked = isDense() && !isCollapsed() &&
+    (!probabilities || computesProbability());
+  const bool early = !scores && !probabilities && votesEarly();
+  const size_t n_dec = std::max(decision_functions(m_model.get()), 1);
+  const size_t l = m_model->l;
+  const size_t block = blocked? std::min(BLOCK_ROWS,
+      std::max((size_t)4, BLOCK_KERNELS / std::max(l, (size_t)1))) : 1;
+
+  const size_t size = labels.extent(0);
+  const size_t blocks = (size + block - 1) / block;
+  auto body = [&](size_t first, size_t last) {
+
+    double* dec_values = thread_scratch<double,DECISION>(block * n_dec);
+
+    for (size_t b=first*block; b<std::min(last*block, size); b+=block) {
+
+      if (!blocked) {
+        const double label = predictSparse(index + ptr[b], value + ptr[b],
+            ptr[b+1] - ptr[b], shifted, dec_values,
+            probabilities? &(*probabilities)(b,0) : 0);
+        labels(b) = round(label);
+        if (scores) std::copy(dec_values, dec_values + scores->extent(1),
+            &(*scores)(b,0));
+        continue;
+      }
+
+      //rows of the dense evaluator are scattered into a block of dense rows
+      const size_t rows = std::min(block, size - b);
+      double* x = thread_scratch<double,SCATTERED>(rows * m_input_size);
+      for (size_t r=0; r<rows; ++r) {
+        scatter(index + ptr[b+r], value + ptr[b+r], ptr[b+r+1] - ptr[b+r],
+            m_input_size, x + r * m_input_size);
+      }
+
+      if (early) {
+        classifyBlock(x, m_input_size, 1, rows, dec_values);
+        for (size_t r=0; r<rows; ++r) labels(b+r) = round(dec_values[r]);
+        continue;
+      }
+
+      decideBlock(x, m_input_size, 1, rows, dec_values);
+      for (size_t r=0; r<rows; ++r) {
+        const double* row_values = dec_values + r * n_dec;
+        labels(b+r) = round(probabilities?
+            probability(row_values, &(*probabilities)(b+r,0)) :
+            vote(row_values));
+        if (scores) std::copy(row_values, row_values + scores->extent(1),
+            &(*scores)(b+r,0));
+      }
+
+    }
+
+  };
+
+  bob::learn::libsvm::parallelFor(blocks, m_threads,
+      std::max(BATCH_GRAIN / block, (size_t)1), boost::cref(body));
+
+}
+
+/**
+ * Checks a sparse input matrix, in CSR format, and the labels array of the
+ * batch prediction methods, raises if these are not consistent.
+ */
+static void check_sparse_batch(const blitz::Array<int64_t,1>& indptr,
+    const blitz::Array<int64_t,1>& indices,
+    const blitz::Array<double,1>& values,
+    const blitz::Array<int64_t,1>& labels) {
+
+  if (!bob::core::array::isCContiguous(indptr) ||
+      !bob::core::array::isCContiguous(indices) ||
+      !bob::core::array::isCContiguous(values)) {
+    throw std::runtime_error("arrays of sparse inputs should be C-style contiguous and what you provided is not");
+  }
+
+  if (indptr.extent(0) != labels.extent(0) + 1) {
+    boost::format s("row pointers of sparse inputs should have %d components, one more than the number of output labels, but you provided an array with %d elements instead");
+    s % (labels.extent(0) + 1) % indptr.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  if (indices.extent(0) != values.extent(0)) {
+    boost::format s("column indices and values of sparse inputs should have the same number of elements, but you provided arrays with %d and %d elements instead");
+    s % indices.extent(0) % values.extent(0);
+    throw std::runtime_error(s.str());
+  }
+
+  const int64_t* ptr = indptr.data();
+  const int64_t* index = indices.data();
+  for (int k=0; k<labels.extent(0); ++k) {
+    if (ptr[k] < 0 || ptr[k] > ptr[k+1] || ptr[k+1] > indices.extent(0)) {
+      boost::format s("row pointers of sparse inputs should increase within [0, %d], but row %d spans [%d, %d)");
+      s % indices.extent(0) % k % ptr[k] % ptr[k+1];
+      throw std::runtime_error(s.str());
+    }
+    for (int64_t e=ptr[k]; e<ptr[k+1]; ++e) {
+      if (index[e] < 0 || (e > ptr[k] && index[e] <= index[e-1])) {
+        boost::format s("column indices of sparse inputs should be non-negative and increase strictly within each row, which is not the case in row %d (sort them with scipy.sparse.csr_matrix.sort_indices(), for example)");
+        s % k;
+        throw std::runtime_error(s.str());
+      }
+    }
+  }
+
+}
+
+void bob::learn::libsvm::Machine::predictClassBatch_
+(const blitz::Array<int64_t,1>& indptr,
+ const blitz::Array<int64_t,1>& indices, const blitz::Array<double,1>& values,
+ blitz::Array<int64_t,1>& labels) const {
+  predictSparseBatch(indptr, indices, values, labels, 0, 0);
+}
+
+void bob::learn::libsvm::Machine::predictClassBatch
+(const blitz::Array<int64_t,1>& indptr,
+ const blitz::Array<int64_t,1>& indices, const blitz::Array<double,1>& values,
+ blitz::Array<int64_t,1>& labels) const {
+  check_sparse_batch(indptr, indices, values, labels);
+  predictClassBatch_(indptr, indices, values, labels);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndScoresBatch_
+(const blitz::Array<int64_t,1>& indptr,
+ const blitz::Array<int64_t,1>& indices, const blitz::Array<double,1>& values,
+ blitz::Array<int64_t,1>& labels, blitz::Array<double,2>& scores) const {
+  predictSparseBatch(indptr, indices, values, labels, &scores, 0);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndScoresBatch
+(const blitz::Array<int64_t,1>& indptr,
+ const blitz::Array<int64_t,1>& indices, const blitz::Array<double,1>& values,
+ blitz::Array<int64_t,1>& labels, blitz::Array<double,2>& scores) const {
+
+  check_sparse_batch(indptr, indices, values, labels);
+
+  if (!bob::core::array::isCContiguous(scores)) {
+    throw std::runtime_error("scores output array should be C-style contiguous and what you provided is not");
+  }
+
+  size_t N = outputSize();
+  size_t size = N < 2 ? 1 : (N*(N-1))/2;
+  if (scores.extent(0) != labels.extent(0) || (size_t)scores.extent(1) != size) {
+    boost::format s("output scores for this SVM (%d classes) should have shape (%d, %d), but you provided an array with shape (%d, %d) instead");
+    s % svm_get_nr_class(m_model.get()) % labels.extent(0) % size % scores.extent(0) % scores.extent(1);
+    throw std::runtime_error(s.str());
+  }
+
+  predictClassAndScoresBatch_(indptr, indices, values, labels, scores);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndProbabilitiesBatch_
+(const blitz::Array<int64_t,1>& indptr,
+ const blitz::Array<int64_t,1>& indices, const blitz::Array<double,1>& values,
+ blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>& probabilities) const {
+  predictSparseBatch(indptr, indices, values, labels, 0, &probabilities);
+}
+
+void bob::learn::libsvm::Machine::predictClassAndProbabilitiesBatch
+(const blitz::Array<int64_t,1>& indptr,
+ const blitz::Array<int64_t,1>& indices, const blitz::Array<double,1>& values,
+ blitz::Array<int64_t,1>& labels,
+ blitz::Array<double,2>& probabilities) const {
+
+  check_sparse_batch(indptr, indices, values, labels);
+
+  if (!supportsProbability()) {
+    throw std::runtime_error("this SVM does not support probabilities");
+  }
+
+  if (!bob::core::array::isCContiguous(probabilities)) {
+    throw std::runtime_error("probabilities output array should be C-style contiguous and what you provided is not");
+  }
+
+  if (probabilities.extent(0) != labels.extent(0) ||
+      (size_t)probabilities.extent(1) != numberOfClasses()) {
+    boost::format s("output probabilities for this SVM should have shape (%d, %d), but you provided an array with shape (%d, %d) instead");
+    s % labels.extent(0) % numberOfClasses() % probabilities.extent(0) % probabilities.extent(1);
+    throw std::runtime_error(s.str());
+  }
+
+  predictClassAndProbabilitiesBatch_(indptr, indices, values, labels,
+      probabilities);
+}
+
+void bob::learn::libsvm::Machine::save(const std::string& filename) const {
+  if (svm_save_model(filename.c_str(), nodeModel().get())) {
+    boost::format s("cannot save SVM model to file '%s'");
+    s % filename;
+    throw std::runtime_error(s.str());
+  }
+}
+
+void bob::learn::libsvm::Machine::saveBinary(const std::string& filename) const {
+  bob::learn::libsvm::svm_write_binary(filename, nodeModel().get(),
+      m_input_size, m_stride, m_input_sub, m_input_div);
 }
 
 void bob::learn::libsvm::Machine::save(bob::io::base::HDF5File& config) const {
-  config.setArray("svm_model", bob::learn::libsvm::svm_pickle(m_model));
+  bob::learn::libsvm::svm_write_hdf5(config, nodeModel().get());
   config.setArray("input_subtract", m_input_sub);
   config.setArray("input_divide", m_input_div);
   uint64_t version = LIBSVM_VERSION;
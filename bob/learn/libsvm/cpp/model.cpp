@@ -0,0 +1,745 @@
+/**
+ * @date Fri 16 Oct 2026 19:20:44 CEST
+ *
+ * @brief Implementation of the in-memory and HDF5 readers and writers of
+ * libsvm models
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#include <bob.learn.libsvm/model.h>
+#include <bob.learn.libsvm/parallel.h>
+#include <bob.learn.libsvm/number.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <stdexcept>
+#include <sstream>
+#include <locale>
+#include <algorithm>
+#include <vector>
+#include <boost/format.hpp>
+#include <boost/ref.hpp>
+
+/**
+ * Names of machine and kernel types in libsvm's text format, in the order of
+ * machine_t and kernel_t
+ */
+static const char* svm_type_table[] = {"c_svc", "nu_svc", "one_class",
+  "epsilon_svr", "nu_svr", 0};
+static const char* kernel_type_table[] = {"linear", "polynomial", "rbf",
+  "sigmoid", "precomputed", 0};
+
+#if LIBSVM_VERSION >= 330
+/**
+ * Number of density marks of one-class machines estimating probabilities,
+ * fixed by libsvm
+ */
+static const int NR_MARKS = 10;
+#endif
+
+/**
+ * A wrapper, to standardize this function.
+ */
+static void svm_model_free(svm_model*& m) {
+#if LIBSVM_VERSION >= 300
+  svm_free_and_destroy_model(&m);
+#else
+  svm_destroy_model(m);
+#endif
+}
+
+/**
+ * Number of pairs of classes, for which there is one decision function
+ */
+static int pairs(const svm_model* model) {
+  return model->nr_class * (model->nr_class - 1) / 2;
+}
+
+template <typename T>
+static void write_array(std::ostream& os, const char* name, const T* values,
+    int size) {
+  os << name;
+  for (int i=0; i<size; ++i) os << ' ' << values[i];
+  os << '\n';
+}
+
+std::string bob::learn::libsvm::svm_format(const svm_model* model) {
+
+  //same output as svm_save_model(), which uses the "C" locale
+  std::ostringstream os;
+  os.imbue(std::locale::classic());
+  os.precision(17);
+
+  const svm_parameter& param = model->param;
+  os << "svm_type " << svm_type_table[param.svm_type] << '\n';
+  os << "kernel_type " << kernel_type_table[param.kernel_type] << '\n';
+
+  if (param.kernel_type == POLY) os << "degree " << param.degree << '\n';
+
+  if (param.kernel_type == POLY || param.kernel_type == RBF ||
+      param.kernel_type == SIGMOID) os << "gamma " << param.gamma << '\n';
+
+  if (param.kernel_type == POLY || param.kernel_type == SIGMOID)
+    os << "coef0 " << param.coef0 << '\n';
+
+  const int nr_class = model->nr_class;
+  const int l = model->l;
+  os << "nr_class " << nr_class << '\n';
+  os << "total_sv " << l << '\n';
+
+  write_array(os, "rho", model->rho, pairs(model));
+  if (model->label) write_array(os, "label", model->label, nr_class);
+  if (model->probA) write_array(os, "probA", model->probA, pairs(model));
+  if (model->probB) write_array(os, "probB", model->probB, pairs(model));
+#if LIBSVM_VERSION >= 330
+  if (model->prob_density_marks) write_array(os, "prob_density_marks",
+      model->prob_density_marks, NR_MARKS);
+#endif
+  if (model->nSV) write_array(os, "nr_sv", model->nSV, nr_class);
+
+  os << "SV\n";
+  for (int i=0; i<l; ++i) {
+    os.precision(17);
+    for (int j=0; j<nr_class-1; ++j) os << model->sv_coef[j][i] << ' ';
+
+    const svm_node* p = model->SV[i];
+    if (param.kernel_type == PRECOMPUTED) {
+      os << "0:" << (int)(p->value) << ' ';
+    }
+    else {
+      os.precision(8);
+      for (; p->index != -1; ++p) os << p->index << ':' << p->value << ' ';
+    }
+    os << '\n';
+  }
+
+  return os.str();
+
+}
+
+static inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+    c == '\f';
+}
+
+/**
+ * Skips white space, except new lines
+ */
+static inline void skip_blanks(const char*& p, const char* end) {
+  while (p < end && *p != '\n' && is_space(*p)) ++p;
+}
+
+/**
+ * Returns the next word of the header, after any white space
+ */
+static std::string read_word(const char*& p, const char* end) {
+  while (p < end && is_space(*p)) ++p;
+  const char* start = p;
+  while (p < end && !is_space(*p)) ++p;
+  return std::string(start, p);
+}
+
+/**
+ * Reads the next number of the header, after any white space. Text must end
+ * with white space, so parseDouble() and strtol() stop before "end".
+ */
+static double read_double(const char*& p, const char* end, const char* what) {
+  while (p < end && is_space(*p)) ++p;
+  char* stop = const_cast<char*>(p);
+  double retval = (p < end) ? bob::learn::libsvm::parseDouble(p, &stop) : 0.;
+  if (stop == p) {
+    boost::format s("cannot read a number for `%s' in libsvm model");
+    s % what;
+    throw std::runtime_error(s.str());
+  }
+  p = stop;
+  return retval;
+}
+
+static int read_int(const char*& p, const char* end, const char* what) {
+  while (p < end && is_space(*p)) ++p;
+  char* stop = const_cast<char*>(p);
+  long retval = (p < end) ? strtol(p, &stop, 10) : 0;
+  if (stop == p || retval < INT_MIN || retval > INT_MAX) {
+    boost::format s("cannot read an integer for `%s' in libsvm model");
+    s % what;
+    throw std::runtime_error(s.str());
+  }
+  p = stop;
+  return retval;
+}
+
+static inline void read_value(const char*& p, const char* end,
+    const char* what, int& value) {
+  value = read_int(p, end, what);
+}
+
+static inline void read_value(const char*& p, const char* end,
+    const char* what, double& value) {
+  value = read_double(p, end, what);
+}
+
+/**
+ * Reads "size" values of a header line into memory allocated as libsvm does,
+ * replacing (and releasing) "values"
+ */
+template <typename T>
+static void read_array(const char*& p, const char* end, const char* what,
+    int size, T*& values) {
+  if (size < 0) {
+    boost::format s("`%s' found before a valid `nr_class' in libsvm model");
+    s % what;
+    throw std::runtime_error(s.str());
+  }
+  free(values);
+  values = static_cast<T*>(malloc(std::max(size, 1) * sizeof(T)));
+  if (!values) throw std::bad_alloc();
+  for (int i=0; i<size; ++i) read_value(p, end, what, values[i]);
+}
+
+/**
+ * Returns the index of "word" in a null-terminated "table"
+ */
+static int lookup(const char* const* table, const std::string& word,
+    const char* what) {
+  for (int i=0; table[i]; ++i) if (word == table[i]) return i;
+  boost::format s("unknown %s `%s' in libsvm model");
+  s % what % word;
+  throw std::runtime_error(s.str());
+}
+
+/**
+ * Reads the header of a model, up to and including the "SV" line. Mirrors
+ * read_model_header() from libsvm.
+ */
+static void read_header(const char*& p, const char* end, svm_model* model) {
+
+  svm_parameter& param = model->param;
+  model->nr_class = -1; ///< until read
+
+  while (true) {
+    const std::string word = read_word(p, end);
+    const char* what = word.c_str();
+
+    if (word.empty()) {
+      throw std::runtime_error("libsvm model ends before its support vectors: `SV' line is missing");
+    }
+    else if (word == "svm_type") {
+      param.svm_type = lookup(svm_type_table, read_word(p, end), "svm type");
+    }
+    else if (word == "kernel_type") {
+      param.kernel_type = lookup(kernel_type_table, read_word(p, end),
+          "kernel type");
+    }
+    else if (word == "degree") param.degree = read_int(p, end, what);
+    else if (word == "gamma") param.gamma = read_double(p, end, what);
+    else if (word == "coef0") param.coef0 = read_double(p, end, what);
+    else if (word == "nr_class") {
+      model->nr_class = read_int(p, end, what);
+      if (model->nr_class < 1) {
+        throw std::runtime_error("`nr_class' of libsvm model should be positive");
+      }
+    }
+    else if (word == "total_sv") {
+      model->l = read_int(p, end, what);
+      if (model->l < 0) {
+        throw std::runtime_error("`total_sv' of libsvm model should not be negative");
+      }
+    }
+    else if (word == "rho") {
+      read_array(p, end, what, model->nr_class < 0 ? -1 : pairs(model),
+          model->rho);
+    }
+    else if (word == "label") {
+      read_array(p, end, what, model->nr_class, model->label);
+    }
+    else if (word == "probA") {
+      read_array(p, end, what, model->nr_class < 0 ? -1 : pairs(model),
+          model->probA);
+    }
+    else if (word == "probB") {
+      read_array(p, end, what, model->nr_class < 0 ? -1 : pairs(model),
+          model->probB);
+    }
+#if LIBSVM_VERSION >= 330
+    else if (word == "prob_density_marks") {
+      read_array(p, end, what, NR_MARKS, model->prob_density_marks);
+    }
+#endif
+    else if (word == "nr_sv") {
+      read_array(p, end, what, model->nr_class, model->nSV);
+    }
+    else if (word == "SV") {
+      const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+      p = eol ? eol + 1 : end;
+      break;
+    }
+    else {
+      boost::format s("unknown text in libsvm model: `%s'");
+      s % word;
+      throw std::runtime_error(s.str());
+    }
+  }
+
+  if (model->nr_class < 0) {
+    throw std::runtime_error("libsvm model does not define `nr_class'");
+  }
+
+}
+
+/**
+ * Reads the line of support vector "i", from "p" to "eol", into
+ * "model->sv_coef" and "nodes". Returns the end of the nodes written. Every
+ * value must be followed by white space. Indices may start at 0, as
+ * svm-train accepts them, but not below: -1 ends libsvm's support vectors.
+ */
+static svm_node* read_vector(const char* p, const char* eol, int i,
+    svm_model* model, svm_node* nodes) {
+
+  for (int k=0; k<model->nr_class-1; ++k) {
+    skip_blanks(p, eol);
+    char* stop = const_cast<char*>(p);
+    if (p < eol) {
+      model->sv_coef[k][i] = bob::learn::libsvm::parseDouble(p, &stop);
+    }
+    if (stop == p || (stop < eol && !is_space(*stop))) {
+      boost::format s("cannot read coefficient %d of support vector %d in libsvm model");
+      s % k % i;
+      throw std::runtime_error(s.str());
+    }
+    p = stop;
+  }
+
+  while (true) {
+    skip_blanks(p, eol);
+    if (p >= eol) break;
+    char* stop = const_cast<char*>(p);
+    long index = strtol(p, &stop, 10);
+    const bool has_value = stop != p && *stop == ':' && !is_space(stop[1]);
+    const char* start = stop + 1;
+    double value = has_value ?
+      bob::learn::libsvm::parseDouble(start, &stop) : 0.;
+    if (!has_value || stop == start || (stop < eol && !is_space(*stop)) ||
+        index < 0 || index > INT_MAX) {
+      boost::format s("cannot read `index:value' pairs of support vector %d in libsvm model");
+      s % i;
+      throw std::runtime_error(s.str());
+    }
+    p = stop;
+    nodes->index = index;
+    nodes->value = value;
+    ++nodes;
+  }
+
+  nodes->index = -1;
+  nodes->value = 0.;
+  return nodes + 1;
+
+}
+
+/**
+ * Smallest number of bytes of support vectors parsed by each thread
+ */
+static const size_t PARSE_GRAIN = 1 << 20;
+
+boost::shared_ptr<svm_model> bob::learn::libsvm::svm_parse
+(const char* data, size_t size, size_t threads) {
+
+  //numbers are converted in place: text must end with white space so that
+  //conversions stop within the buffer
+  if (size && !is_space(data[size-1])) {
+    std::string copy(data, size);
+    copy += '\n';
+    return svm_parse(copy.data(), copy.size(), threads);
+  }
+
+  const char* p = data;
+  const char* end = data + size;
+
+  //allocated as by svm_load_model(), so libsvm can release it
+  svm_model* raw = static_cast<svm_model*>(calloc(1, sizeof(svm_model)));
+  if (!raw) throw std::bad_alloc();
+  boost::shared_ptr<svm_model> model(raw, std::ptr_fun(svm_model_free));
+
+  read_header(p, end, raw);
+
+  //support vectors are split in chunks of whole lines, one per thread
+  const size_t chunks = std::max((size_t)1,
+      std::min(threads, (size_t)(end - p) / PARSE_GRAIN));
+  std::vector<const char*> bound(chunks + 1, end);
+  bound[0] = p;
+  for (size_t k=1; k<chunks; ++k) {
+    const char* q = std::max(p + (end - p) / chunks * k, bound[k-1]);
+    const char* eol = static_cast<const char*>(memchr(q, '\n', end - q));
+    bound[k] = eol ? eol + 1 : end;
+  }
+
+  //lines and ':' of every chunk tell where its support vectors and nodes
+  //start: each line holds one support vector, with a node per ':' and a
+  //terminator
+  std::vector<size_t> lines(chunks);
+  std::vector<size_t> colons(chunks);
+  auto count = [&](size_t start, size_t stop) {
+    for (size_t k=start; k<stop; ++k) {
+      size_t n = 0, c = 0;
+      for (const char* q = bound[k]; q < bound[k+1]; ++q) {
+        n += (*q == '\n');
+        c += (*q == ':');
+      }
+      //the last line may not end with a new line
+      if (bound[k] < bound[k+1] && bound[k+1][-1] != '\n') ++n;
+      lines[k] = n;
+      colons[k] = c;
+    }
+  };
+  bob::learn::libsvm::parallelFor(chunks, threads, 1, boost::cref(count));
+
+  const int m = raw->nr_class - 1;
+  const int l = raw->l;
+  std::vector<size_t> first_sv(chunks + 1, 0);
+  std::vector<size_t> first_node(chunks + 1, 0);
+  for (size_t k=0; k<chunks; ++k) {
+    first_sv[k+1] = first_sv[k] + lines[k];
+    first_node[k+1] = first_node[k] + lines[k] + colons[k];
+  }
+  if (first_sv[chunks] < (size_t)l) {
+    boost::format s("libsvm model has %d support vectors, but its `total_sv' is %d");
+    s % first_sv[chunks] % l;
+    throw std::runtime_error(s.str());
+  }
+
+  //all nodes, including the terminator of each support vector, are in a
+  //single block at SV[0]
+  const size_t nodes = l + first_node[chunks] - first_sv[chunks];
+
+  raw->sv_coef = static_cast<double**>(calloc(std::max(m, 1),
+        sizeof(double*)));
+  if (!raw->sv_coef) throw std::bad_alloc();
+  for (int k=0; k<m; ++k) {
+    raw->sv_coef[k] = static_cast<double*>(malloc(std::max(l, 1) *
+          sizeof(double)));
+    if (!raw->sv_coef[k]) throw std::bad_alloc();
+  }
+
+  raw->SV = static_cast<svm_node**>(calloc(std::max(l, 1),
+        sizeof(svm_node*)));
+  if (!raw->SV) throw std::bad_alloc();
+  if (l) {
+    raw->SV[0] = static_cast<svm_node*>(malloc(nodes * sizeof(svm_node)));
+    if (!raw->SV[0]) throw std::bad_alloc();
+  }
+  raw->free_sv = 1;
+  if (!l) return model;
+
+  //lines after the last support vector are ignored, as libsvm does
+  svm_node* space = raw->SV[0];
+  auto parse = [&](size_t start, size_t stop) {
+    for (size_t k=start; k<stop; ++k) {
+      size_t i = first_sv[k];
+      svm_node* next = space + first_node[k];
+      for (const char* q = bound[k]; q < bound[k+1] && i < (size_t)l; ++i) {
+        const char* eol = static_cast<const char*>(memchr(q, '\n',
+              bound[k+1] - q));
+        if (!eol) eol = bound[k+1];
+        raw->SV[i] = next;
+        next = read_vector(q, eol, i, raw, next);
+        q = eol + 1;
+      }
+    }
+  };
+  bob::learn::libsvm::parallelFor(chunks, threads, 1, boost::cref(parse));
+
+  return model;
+
+}
+
+/**
+ * Writes "size" values as a 1D dataset of type T, unless there are none
+ */
+template <typename T, typename V>
+static void write_dataset(bob::io::base::HDF5File& config, const char* name,
+    const V* values, int size) {
+  if (!values || size <= 0) return;
+  blitz::Array<T,1> array(size);
+  std::copy(values, values + size, array.data());
+  config.setArray(name, array);
+}
+
+void bob::learn::libsvm::svm_write_hdf5(bob::io::base::HDF5File& config,
+    const svm_model* model) {
+
+  const svm_parameter& param = model->param;
+  config.set("svm_type", (int64_t)param.svm_type);
+  config.set("kernel_type", (int64_t)param.kernel_type);
+  config.set("degree", (int64_t)param.degree);
+  config.set("gamma", param.gamma);
+  config.set("coef0", param.coef0);
+
+  const int nr_class = model->nr_class;
+  const int l = model->l;
+  config.set("nr_class", (int64_t)nr_class);
+  config.set("total_sv", (int64_t)l);
+
+  write_dataset<double>(config, "rho", model->rho, pairs(model));
+  write_dataset<double>(config, "probA", model->probA, pairs(model));
+  write_dataset<double>(config, "probB", model->probB, pairs(model));
+#if LIBSVM_VERSION >= 330
+  write_dataset<double>(config, "prob_density_marks",
+      model->prob_density_marks, NR_MARKS);
+#endif
+  write_dataset<int64_t>(config, "label", model->label, nr_class);
+  write_dataset<int64_t>(config, "nSV", model->nSV, nr_class);
+
+  if (nr_class > 1 && l > 0) {
+    blitz::Array<double,2> sv_coef(nr_class - 1, l);
+    for (int k=0; k<nr_class-1; ++k) {
+      std::copy(model->sv_coef[k], model->sv_coef[k] + l, &sv_coef(k, 0));
+    }
+    config.setArray("sv_coef", sv_coef);
+  }
+
+  size_t values = 0;
+  int columns = 0;
+  int first = 1; ///< smallest index
+  for (int k=0; k<l; ++k) {
+    for (const svm_node* p = model->SV[k]; p->index != -1; ++p) {
+      ++values;
+      columns = std::max(columns, p->index);
+      first = std::min(first, p->index);
+    }
+  }
+
+  //same choice as Machine's default representation, see Machine::reset()
+  if (param.kernel_type != PRECOMPUTED && l > 0 && columns > 0 &&
+      first >= 1 && (size_t)l * columns <= 2 * (values + l)) {
+    blitz::Array<double,2> sv(l, columns);
+    sv = 0.;
+    for (int k=0; k<l; ++k) {
+      for (const svm_node* p = model->SV[k]; p->index != -1; ++p) {
+        sv(k, p->index - 1) = p->value;
+      }
+    }
+    config.setArray("support_vectors", sv);
+    return;
+  }
+
+  blitz::Array<int64_t,1> indptr(l + 1);
+  blitz::Array<int64_t,1> indices(std::max(values, (size_t)1));
+  blitz::Array<double,1> sv_values(std::max(values, (size_t)1));
+  size_t position = 0;
+  for (int k=0; k<l; ++k) {
+    indptr(k) = position;
+    for (const svm_node* p = model->SV[k]; p->index != -1; ++p) {
+      indices(position) = p->index;
+      sv_values(position) = p->value;
+      ++position;
+    }
+  }
+  indptr(l) = position;
+  config.setArray("sv_indptr", indptr);
+  if (values) {
+    config.setArray("sv_indices", indices);
+    config.setArray("sv_values", sv_values);
+  }
+
+}
+
+/**
+ * Reads a 1D dataset of "size" values into memory allocated as libsvm does,
+ * replacing (and releasing) "values". The dataset may be missing if it has
+ * no values or if "optional" is set, in which case "values" is left as is.
+ */
+template <typename T, typename V>
+static void read_dataset(bob::io::base::HDF5File& config, const char* name,
+    int size, bool optional, V*& values) {
+  if (!config.contains(name)) {
+    if (optional || size == 0) return;
+    boost::format s("libsvm model in HDF5 file does not define `%s'");
+    s % name;
+    throw std::runtime_error(s.str());
+  }
+  const blitz::Array<T,1> array = config.readArray<T,1>(name);
+  if (array.extent(0) != size) {
+    boost::format s("`%s' of libsvm model in HDF5 file should have %d values, not %d");
+    s % name % size % array.extent(0);
+    throw std::runtime_error(s.str());
+  }
+  free(values);
+  values = static_cast<V*>(malloc(std::max(size, 1) * sizeof(V)));
+  if (!values) throw std::bad_alloc();
+  for (int i=0; i<size; ++i) values[i] = array(i);
+}
+
+/**
+ * Reads an integer scalar of the model, which should be in [min, max]
+ */
+static int read_scalar(bob::io::base::HDF5File& config, const char* name,
+    int64_t min, int64_t max) {
+  const int64_t value = config.read<int64_t>(name);
+  if (value < min || value > max) {
+    boost::format s("`%s' of libsvm model in HDF5 file is out of range: %d");
+    s % name % value;
+    throw std::runtime_error(s.str());
+  }
+  return value;
+}
+
+boost::shared_ptr<svm_model> bob::learn::libsvm::svm_read_hdf5
+(bob::io::base::HDF5File& config) {
+
+  //allocated as by svm_load_model(), so libsvm can release it
+  svm_model* raw = static_cast<svm_model*>(calloc(1, sizeof(svm_model)));
+  if (!raw) throw std::bad_alloc();
+  boost::shared_ptr<svm_model> model(raw, std::ptr_fun(svm_model_free));
+
+  svm_parameter& param = raw->param;
+  param.svm_type = read_scalar(config, "svm_type", C_SVC, NU_SVR);
+  param.kernel_type = read_scalar(config, "kernel_type", LINEAR,
+      PRECOMPUTED);
+  param.degree = read_scalar(config, "degree", INT_MIN, INT_MAX);
+  param.gamma = config.read<double>("gamma");
+  param.coef0 = config.read<double>("coef0");
+
+  raw->nr_class = read_scalar(config, "nr_class", 1, INT_MAX);
+  raw->l = read_scalar(config, "total_sv", 0, INT_MAX);
+  const int m = raw->nr_class - 1;
+  const int l = raw->l;
+
+  read_dataset<double>(config, "rho", pairs(raw), false, raw->rho);
+  read_dataset<double>(config, "probA", pairs(raw), true, raw->probA);
+  read_dataset<double>(config, "probB", pairs(raw), true, raw->probB);
+#if LIBSVM_VERSION >= 330
+  read_dataset<double>(config, "prob_density_marks", NR_MARKS, true,
+      raw->prob_density_marks);
+#endif
+  //classifiers need both to pair their support vectors and coefficients
+  const bool classifier = param.svm_type == C_SVC ||
+    param.svm_type == NU_SVC;
+  read_dataset<int64_t>(config, "label", raw->nr_class, !classifier,
+      raw->label);
+  read_dataset<int64_t>(config, "nSV", raw->nr_class, !classifier, raw->nSV);
+  if (raw->nSV) {
+    int64_t total = 0;
+    for (int i=0; i<raw->nr_class; ++i) {
+      if (raw->nSV[i] < 0) {
+        boost::format s("`nSV' of libsvm model in HDF5 file should not be negative: %d");
+        s % raw->nSV[i];
+        throw std::runtime_error(s.str());
+      }
+      total += raw->nSV[i];
+    }
+    if (total != raw->l) {
+      boost::format s("`nSV' of libsvm model in HDF5 file should sum to `total_sv' (%d), not to %d");
+      s % raw->l % total;
+      throw std::runtime_error(s.str());
+    }
+  }
+
+  raw->sv_coef = static_cast<double**>(calloc(std::max(m, 1),
+        sizeof(double*)));
+  if (!raw->sv_coef) throw std::bad_alloc();
+  for (int k=0; k<m; ++k) {
+    raw->sv_coef[k] = static_cast<double*>(malloc(std::max(l, 1) *
+          sizeof(double)));
+    if (!raw->sv_coef[k]) throw std::bad_alloc();
+  }
+  if (m > 0 && l > 0) {
+    const blitz::Array<double,2> sv_coef =
+      config.readArray<double,2>("sv_coef");
+    if (sv_coef.extent(0) != m || sv_coef.extent(1) != l) {
+      boost::format s("`sv_coef' of libsvm model in HDF5 file should have shape (%d, %d), not (%d, %d)");
+      s % m % l % sv_coef.extent(0) % sv_coef.extent(1);
+      throw std::runtime_error(s.str());
+    }
+    for (int k=0; k<m; ++k) {
+      for (int i=0; i<l; ++i) raw->sv_coef[k][i] = sv_coef(k, i);
+    }
+  }
+
+  raw->SV = static_cast<svm_node**>(calloc(std::max(l, 1),
+        sizeof(svm_node*)));
+  if (!raw->SV) throw std::bad_alloc();
+  raw->free_sv = 1;
+  if (!l) return model;
+
+  //all nodes, including the terminator of each support vector, are in a
+  //single block at SV[0], as svm_parse() allocates them
+  auto allocate = [&](size_t values) -> svm_node* {
+    raw->SV[0] = static_cast<svm_node*>(malloc((values + l) *
+          sizeof(svm_node)));
+    if (!raw->SV[0]) throw std::bad_alloc();
+    return raw->SV[0];
+  };
+
+  if (config.contains("support_vectors")) {
+    const blitz::Array<double,2> sv =
+      config.readArray<double,2>("support_vectors");
+    if (sv.extent(0) != l) {
+      boost::format s("`support_vectors' of libsvm model in HDF5 file should have %d rows, not %d");
+      s % l % sv.extent(0);
+      throw std::runtime_error(s.str());
+    }
+    const int columns = sv.extent(1);
+    size_t values = 0;
+    for (int k=0; k<l; ++k) {
+      for (int i=0; i<columns; ++i) if (sv(k, i) != 0.) ++values;
+    }
+    svm_node* next = allocate(values);
+    for (int k=0; k<l; ++k) {
+      raw->SV[k] = next;
+      for (int i=0; i<columns; ++i) {
+        if (sv(k, i) == 0.) continue;
+        next->index = i + 1;
+        next->value = sv(k, i);
+        ++next;
+      }
+      next->index = -1;
+      next->value = 0.;
+      ++next;
+    }
+    return model;
+  }
+
+  const blitz::Array<int64_t,1> indptr =
+    config.readArray<int64_t,1>("sv_indptr");
+  const size_t values = (indptr.extent(0) == l + 1) ? indptr(l) : 0;
+  blitz::Array<int64_t,1> indices;
+  blitz::Array<double,1> sv_values;
+  if (values) {
+    indices.reference(config.readArray<int64_t,1>("sv_indices"));
+    sv_values.reference(config.readArray<double,1>("sv_values"));
+  }
+  bool valid = indptr.extent(0) == l + 1 && indptr(0) == 0 &&
+    (size_t)indices.extent(0) == values &&
+    (size_t)sv_values.extent(0) == values;
+  for (int k=0; valid && k<l; ++k) valid = indptr(k) <= indptr(k+1);
+  if (!valid) {
+    throw std::runtime_error("`sv_indptr', `sv_indices' and `sv_values' of libsvm model in HDF5 file are inconsistent");
+  }
+
+  //indices are sorted, as libsvm's kernels expect, from 0 on: svm-train
+  //accepts index 0, which svm_write_hdf5() stores in this format
+  svm_node* next = allocate(values);
+  for (int k=0; k<l; ++k) {
+    raw->SV[k] = next;
+    for (int64_t j=indptr(k); j<indptr(k+1); ++j) {
+      const int64_t previous = (j > indptr(k)) ? indices(j-1) : -1;
+      if (indices(j) <= previous || indices(j) > INT_MAX) {
+        boost::format s("invalid index %d in support vector %d of libsvm model in HDF5 file");
+        s % indices(j) % k;
+        throw std::runtime_error(s.str());
+      }
+      next->index = indices(j);
+      next->value = sv_values(j);
+      ++next;
+    }
+    next->index = -1;
+    next->value = 0.;
+    ++next;
+  }
+
+  return model;
+
+}
@@ -0,0 +1,32 @@
+/**
+ * @date Sat 17 Oct 2026 09:41:05 CEST
+ *
+ * @brief Implementation of the locale-independent parsing of numbers
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#include <bob.learn.libsvm/number.h>
+
+#include <cstdlib>
+#include <clocale>
+#include <locale.h>
+#ifdef __APPLE__
+#  include <xlocale.h>
+#endif
+
+/**
+ * The "C" locale, created once and never released, as it may be used until
+ * the process exits. Null if it cannot be created.
+ */
+static locale_t c_locale() {
+  static const locale_t retval = newlocale(LC_NUMERIC_MASK, "C",
+      (locale_t)0);
+  return retval;
+}
+
+double bob::learn::libsvm::parseDouble(const char* p, char** end) {
+  const locale_t locale = c_locale();
+  if (!locale) return strtod(p, end); ///< out of memory, at start
+  return strtod_l(p, end, locale);
+}
@@ -0,0 +1,261 @@
+/**
+ * @date Fri 16 Oct 2026 10:12:31 CEST
+ *
+ * @brief Implementation of the threading helpers
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#include <bob.learn.libsvm/parallel.h>
+
+#include <cstdlib>
+#include <vector>
+#include <exception>
+#include <pthread.h>
+#include <boost/thread.hpp>
+#include <boost/make_shared.hpp>
+
+size_t bob::learn::libsvm::defaultThreads() {
+  const char* value = getenv("BOB_LEARN_LIBSVM_THREADS");
+  if (!value) return 1;
+  char* end = 0;
+  long threads = strtol(value, &end, 10);
+  if (end == value || *end || threads < 0) return 1;
+  if (threads == 0) {
+    size_t hardware = boost::thread::hardware_concurrency();
+    return hardware ? hardware : 1;
+  }
+  return threads;
+}
+
+/**
+ * Set while the calling thread runs a chunk of parallelFor() split over
+ * several threads. Calls made from there run serially, instead of waiting on
+ * workers that may all be busy.
+ */
+static thread_local bool s_parallel = false;
+
+bool bob::learn::libsvm::inParallelFor() {
+  return s_parallel;
+}
+
+/**
+ * Runs one chunk and returns any exception thrown, so it can be re-thrown on
+ * the calling thread.
+ */
+static std::exception_ptr run_chunk(
+    const boost::function<void (size_t, size_t)>& f, size_t start,
+    size_t end) {
+  s_parallel = true;
+  try {
+    f(start, end);
+  }
+  catch (...) {
+    s_parallel = false;
+    return std::current_exception();
+  }
+  s_parallel = false;
+  return std::exception_ptr();
+}
+
+namespace {
+
+  /**
+   * Counts the chunks of one call to parallelFor() still running and keeps
+   * the exception thrown by the first chunk that failed, if any
+   */
+  class Latch {
+
+    public:
+
+      Latch(size_t count): m_count(count), m_failed(count + 1) {}
+
+      void countDown(size_t chunk, const std::exception_ptr& error) {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        if (error && chunk < m_failed) {
+          m_error = error;
+          m_failed = chunk;
+        }
+        if (--m_count == 0) m_done.notify_all();
+      }
+
+      /**
+       * Waits for all chunks and re-throws the exception kept, if any
+       */
+      void wait() {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (m_count) m_done.wait(lock);
+        if (m_error) std::rethrow_exception(m_error);
+      }
+
+    private:
+
+      boost::mutex m_mutex;
+      boost::condition_variable m_done;
+      size_t m_count;
+      size_t m_failed; ///< index of the chunk that threw m_error
+      std::exception_ptr m_error;
+
+  };
+
+  /**
+   * One chunk of a call to parallelFor(), queued for a worker. Everything it
+   * points to lives on the stack of the caller, which waits on "pending".
+   */
+  struct Chunk {
+    const boost::function<void (size_t, size_t)>* f;
+    size_t index;
+    size_t start;
+    size_t end;
+    Latch* pending;
+  };
+
+  /**
+   * Chunks queued for one worker. The vector is cleared, not freed, once all
+   * chunks were taken, so queueing does not allocate memory once warm.
+   */
+  struct Queue {
+    std::vector<Chunk> chunks;
+    size_t next;
+  };
+
+  /**
+   * Worker threads shared by all calls to parallelFor(). Threads are started
+   * on demand, up to the largest number of workers requested so far, and live
+   * as long as the process. Each worker has its own queue, so chunk k of a
+   * call always runs on worker k - 1: repeated calls of the same size reuse
+   * the thread-local scratch memory warmed by the previous ones.
+   */
+  class Pool {
+
+    public:
+
+      /**
+       * The pool is never destroyed: joining threads while the process exits
+       * (e.g., from the Python interpreter finalization) may deadlock.
+       */
+      static Pool& instance() {
+        return *s_instance;
+      }
+
+      /**
+       * Makes sure the pool has at least "size" threads. If a thread cannot
+       * be started, throws before any chunk is queued.
+       */
+      void reserve(size_t size) {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        if (m_workers.size() >= size) return;
+        m_queues.reserve(size);
+        m_workers.reserve(size);
+        while (m_workers.size() < size) {
+          size_t index = m_workers.size();
+          m_queues.push_back(Queue());
+          m_queues.back().next = 0;
+          try {
+            m_workers.push_back(boost::make_shared<boost::thread>(
+                  [this, index]() { work(index); }));
+          }
+          catch (...) {
+            m_queues.pop_back();
+            throw;
+          }
+        }
+      }
+
+      /**
+       * Queues a chunk for the given worker, which must have been reserved
+       */
+      void submit(size_t worker, const Chunk& chunk) {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_queues[worker].chunks.push_back(chunk);
+        m_ready.notify_all();
+      }
+
+    private:
+
+      /**
+       * Creates the pool of the process, once, when the library is loaded
+       */
+      static Pool* create() {
+        pthread_atfork(0, 0, &Pool::forked);
+        return new Pool;
+      }
+
+      /**
+       * Runs in the child of fork(), where none of the workers exist and the
+       * mutex may have been held by one of them. The pool of the parent is
+       * left behind, leaked, and a new one starts threads on demand.
+       */
+      static void forked() {
+        s_instance = new Pool;
+      }
+
+      static Pool* s_instance;
+
+      void work(size_t index) {
+        while (true) {
+          Chunk chunk;
+          {
+            boost::unique_lock<boost::mutex> lock(m_mutex);
+            while (m_queues[index].next == m_queues[index].chunks.size()) {
+              m_ready.wait(lock);
+            }
+            Queue& queue = m_queues[index];
+            chunk = queue.chunks[queue.next++];
+            if (queue.next == queue.chunks.size()) {
+              queue.chunks.clear();
+              queue.next = 0;
+            }
+          }
+          chunk.pending->countDown(chunk.index,
+              run_chunk(*chunk.f, chunk.start, chunk.end));
+        }
+      }
+
+      boost::mutex m_mutex;
+      boost::condition_variable m_ready;
+      std::vector<Queue> m_queues;
+      std::vector<boost::shared_ptr<boost::thread> > m_workers;
+
+  };
+
+  Pool* Pool::s_instance = Pool::create();
+
+}
+
+void bob::learn::libsvm::parallelFor(size_t size, size_t threads,
+    size_t grain, const boost::function<void (size_t, size_t)>& f) {
+
+  if (!size) return;
+  if (!grain) grain = 1;
+
+  size_t chunks = std::min(threads, (size + grain - 1) / grain);
+  if (chunks < 2 || s_parallel) {
+    f(0, size);
+    return;
+  }
+
+  Pool& pool = Pool::instance();
+  pool.reserve(chunks - 1);
+
+  Latch pending(chunks);
+  size_t step = size / chunks;
+  size_t extra = size % chunks; ///< the first chunks take 1 more element
+
+  size_t start = step + (extra ? 1 : 0); ///< first chunk runs here, later
+  for (size_t k=1; k<chunks; ++k) {
+    size_t end = start + step + (k < extra ? 1 : 0);
+    Chunk chunk = {&f, k, start, end, &pending};
+    try {
+      pool.submit(k - 1, chunk);
+    }
+    catch (...) { //could not queue the chunk, runs it here
+      pending.countDown(k, run_chunk(f, start, end));
+    }
+    start = end;
+  }
+
+  pending.countDown(0, run_chunk(f, 0, step + (extra ? 1 : 0)));
+  pending.wait();
+
+}
@@ -263,12 +263,12 @@ bob::learn::libsvm::Machine* bob::learn::libsvm::Trainer::train
 
   const_cast<double&>(m_param.gamma) = save_gamma;
 
-  //save newly created machine to file, reload from there to get rid of memory
+  //pickle the newly created machine and reload it, in memory, to get rid of
   //dependencies due to the poorly implemented memory model in libsvm
   boost::shared_ptr<svm_model> new_model =
     bob::learn::libsvm::svm_unpickle(bob::learn::libsvm::svm_pickle(model));
 
-  auto retval = new bob::learn::libsvm::Machine(new_model);
+  auto retval = new bob::learn::libsvm::Machine(new_model, true);
 
   //sets up the scaling parameters given as input
   retval->setInputSubtraction(input_subtraction);
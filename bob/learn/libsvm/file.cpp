@@ -38,10 +38,12 @@ from ``1`` (and not from zero as a C-programmer would expect).\n\
 The values are floating point. Zero values are suppressed -\n\
 LIBSVM uses a sparse format.\n\
 \n\
-Upon construction, objects of this class will inspect the input\n\
+When first needed, objects of this class will inspect the input\n\
 file so that the maximum sample size is computed. Once that job\n\
 is performed, you can read the data in your own pace using the\n\
-:py:meth:`read` method.\n\
+:py:meth:`read` method. Reading the whole file with\n\
+:py:meth:`read_all` instead computes the sample size on the\n\
+way, so the file is only read once.\n\
 \n\
 This class is made available to you so you can input original\n\
 LIBSVM files and convert them to another better supported\n\
@@ -115,6 +117,38 @@ static PyObject* PyBobLearnLibsvmFile_getFilename
   return Py_BuildValue("s", self->cxx->filename().c_str());
 }
 
+PyDoc_STRVAR(s_n_threads_str, "n_threads");
+PyDoc_STRVAR(s_n_threads_doc,
+"The number of threads used to inspect the file and by\n\
+:py:meth:`read_all`. The file is split in chunks of whole\n\
+lines, one per thread, so results do not depend on this\n\
+setting. Setting it to ``0`` selects the number of hardware\n\
+threads available. The default is read from the environment\n\
+variable ``BOB_LEARN_LIBSVM_THREADS`` when the file is opened\n\
+(``1``, if that is not set).\n\
+");
+
+static PyObject* PyBobLearnLibsvmFile_getNumberOfThreads
+(PyBobLearnLibsvmFileObject* self, void* /*closure*/) {
+  return Py_BuildValue("n", self->cxx->getNumberOfThreads());
+}
+
+static int PyBobLearnLibsvmFile_setNumberOfThreads
+(PyBobLearnLibsvmFileObject* self, PyObject* o, void* /*closure*/) {
+
+  Py_ssize_t threads = PyNumber_AsSsize_t(o, PyExc_OverflowError);
+  if (PyErr_Occurred()) return -1;
+
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires a non-negative number of threads, not %" PY_FORMAT_SIZE_T "d", Py_TYPE(self)->tp_name, threads);
+    return -1;
+  }
+
+  self->cxx->setNumberOfThreads(threads);
+  return 0;
+
+}
+
 static PyGetSetDef PyBobLearnLibsvmFile_getseters[] = {
     {
       s_shape_str,
@@ -137,6 +171,13 @@ static PyGetSetDef PyBobLearnLibsvmFile_getseters[] = {
       s_filename_doc,
       0
     },
+    {
+      s_n_threads_str,
+      (getter)PyBobLearnLibsvmFile_getNumberOfThreads,
+      (setter)PyBobLearnLibsvmFile_setNumberOfThreads,
+      s_n_threads_doc,
+      0
+    },
     {0}  /* Sentinel */
 };
 
@@ -195,8 +236,8 @@ PyDoc_STRVAR(s_reset_str, "reset");
 PyDoc_STRVAR(s_reset_doc,
 "o.reset() -> None\n\
 \n\
-Resets the current file so it starts reading from the begin\n\
-once more.\n\
+Resets the current file so :py:meth:`read` starts reading\n\
+from the begin once more. The file is not read again.\n\
 ");
 
 PyObject* PyBobLearnLibsvmFile_reset(PyBobLearnLibsvmFileObject* self) {
@@ -373,6 +414,197 @@ static PyObject* PyBobLearnLibsvmFile_read
 
 }
 
+PyDoc_STRVAR(s_read_sample_str, "read_sample");
+PyDoc_STRVAR(s_read_sample_doc,
+"o.read_sample(index, [values]) -> (int, array)\n\
+\n\
+Reads sample ``index`` of the file, which must be smaller\n\
+than :py:attr:`samples`, and returns a tuple containing its\n\
+label and a numpy array of ``float64`` elements, as\n\
+:py:meth:`read` does. Samples can be read in any order,\n\
+without reading the file again: this does not change the\n\
+position of :py:meth:`read`.\n\
+\n\
+If the output array ``values`` is provided, it must be a\n\
+64-bit float array with a shape matching the file shape as\n\
+defined by :py:attr:`shape`.\n\
+\n\
+");
+
+static PyObject* PyBobLearnLibsvmFile_read_sample
+(PyBobLearnLibsvmFileObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"index", "values", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t index = 0;
+  PyBlitzArrayObject* values = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "n|O&", kwlist,
+        &index,
+        &PyBlitzArray_OutputConverter, &values
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto values_ = make_xsafe(values);
+
+  if (index < 0) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' cannot read sample %" PY_FORMAT_SIZE_T "d: indexes should not be negative", Py_TYPE(self)->tp_name, index);
+    return 0;
+  }
+
+  if (values && values->type_num != NPY_FLOAT64) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 64-bit float arrays for output array `values'", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  if (values && values->ndim != 1) {
+    PyErr_Format(PyExc_RuntimeError, "Output arrays should always be 1D but you provided an object with %" PY_FORMAT_SIZE_T "d dimensions", values->ndim);
+    return 0;
+  }
+
+  int label = 0;
+
+  try {
+    /** if ``values`` was not pre-allocated, do it now **/
+    if (!values) {
+      Py_ssize_t osize = self->cxx->shape();
+      values = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 1, &osize);
+      values_ = make_xsafe(values);
+      if (!values) return 0;
+    }
+    auto bz = PyBlitzArrayCxx_AsBlitz<double,1>(values);
+    self->cxx->read(index, label, *bz);
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot read data: unknown exception caught", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  Py_INCREF(values);
+  return Py_BuildValue("iO",
+      label,
+      PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(values))
+      );
+
+}
+
+PyDoc_STRVAR(s_read_samples_str, "read_samples");
+PyDoc_STRVAR(s_read_samples_doc,
+"o.read_samples(start, stop, [labels, [values]]) -> (array, array)\n\
+\n\
+Reads samples ``start`` to ``stop - 1`` of the file into the\n\
+output arrays ``labels`` and ``values``, as :py:meth:`read_all`\n\
+does for all samples. Samples are found without reading the\n\
+file again: this does not change the position of\n\
+:py:meth:`read`. Ranges beyond :py:attr:`samples` raise.\n\
+\n\
+The array ``labels``, if provided, must be a 1D\n\
+:py:class:`numpy.ndarray` with data type ``int64`` and\n\
+``stop - start`` positions. The array ``values``, if provided,\n\
+must be a 2D array with data type ``float64``, as many rows as\n\
+``labels`` and as many columns as defined by the attribute\n\
+:py:attr:`shape`. Arrays which are not provided are allocated\n\
+internally and returned.\n\
+\n\
+");
+
+static PyObject* PyBobLearnLibsvmFile_read_samples
+(PyBobLearnLibsvmFileObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"start", "stop", "labels", "values", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  Py_ssize_t start = 0;
+  Py_ssize_t stop = 0;
+  PyBlitzArrayObject* labels = 0;
+  PyBlitzArrayObject* values = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "nn|O&O&", kwlist,
+        &start, &stop,
+        &PyBlitzArray_OutputConverter, &labels,
+        &PyBlitzArray_OutputConverter, &values
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto labels_ = make_xsafe(labels);
+  auto values_ = make_xsafe(values);
+
+  if (start < 0 || stop < start) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' cannot read samples %" PY_FORMAT_SIZE_T "d to %" PY_FORMAT_SIZE_T "d: `start' should not be negative, nor greater than `stop'", Py_TYPE(self)->tp_name, start, stop);
+    return 0;
+  }
+
+  if (labels && labels->type_num != NPY_INT64) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 64-bit integer arrays for output array `labels'", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  if (values && values->type_num != NPY_FLOAT64) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 64-bit float arrays for output array `values'", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  if (labels && labels->ndim != 1) {
+    PyErr_Format(PyExc_RuntimeError, "Output array `labels' should always be 1D but you provided an object with %" PY_FORMAT_SIZE_T "d dimensions", labels->ndim);
+    return 0;
+  }
+
+  if (values && values->ndim != 2) {
+    PyErr_Format(PyExc_RuntimeError, "Output array `values' should always be 2D but you provided an object with %" PY_FORMAT_SIZE_T "d dimensions", values->ndim);
+    return 0;
+  }
+
+  if (labels && labels->shape[0] != stop - start) {
+    PyErr_Format(PyExc_RuntimeError, "1D `labels' array should have %" PY_FORMAT_SIZE_T "d elements matching the number of samples to read, not %" PY_FORMAT_SIZE_T "d rows", stop - start, labels->shape[0]);
+    return 0;
+  }
+
+  try {
+    /** if ``labels`` was not pre-allocated, do it now **/
+    if (!labels) {
+      Py_ssize_t osize = stop - start;
+      labels = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT64, 1, &osize);
+      labels_ = make_xsafe(labels);
+      if (!labels) return 0;
+    }
+
+    /** if ``values`` was not pre-allocated, do it now **/
+    if (!values) {
+      Py_ssize_t osize[2];
+      osize[0] = stop - start;
+      osize[1] = self->cxx->shape();
+      values = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, osize);
+      values_ = make_xsafe(values);
+      if (!values) return 0;
+    }
+
+    auto bzlab = PyBlitzArrayCxx_AsBlitz<int64_t,1>(labels);
+    auto bzval = PyBlitzArrayCxx_AsBlitz<double,2>(values);
+    self->cxx->read(start, *bzlab, *bzval);
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot read data: unknown exception caught", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  Py_INCREF(labels);
+  Py_INCREF(values);
+  return Py_BuildValue("OO",
+      PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(labels)),
+      PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(values))
+      );
+
+}
+
 PyDoc_STRVAR(s_read_all_str, "read_all");
 PyDoc_STRVAR(s_read_all_doc,
 "o.read_all([labels, [values]) -> (array, array)\n\
@@ -391,6 +623,12 @@ defined by the attribute :py:attr:`shape`.\n\
 \n\
 If the output arrays ``labels`` and/or ``values`` are not\n\
 provided, they will be allocated internally and returned.\n\
+The file is scanned first, if it was not inspected yet, so\n\
+values are then parsed straight into the output arrays.\n\
+\n\
+The file is split in chunks of whole lines, parsed by\n\
+:py:attr:`n_threads` concurrent threads, without holding\n\
+Python's global interpreter lock.\n\
 \n\
 .. note::\n\
 \n\
@@ -404,9 +642,6 @@ provided, they will be allocated internally and returned.\n\
 static PyObject* PyBobLearnLibsvmFile_read_all
 (PyBobLearnLibsvmFileObject* self, PyObject* args, PyObject* kwds) {
 
-  // before doing anything, check file status and returns if that is the case
-  if (!self->cxx->good()) Py_RETURN_NONE;
-
   static const char* const_kwlist[] = {"labels", "values", 0};
   static char** kwlist = const_cast<char**>(const_kwlist);
 
@@ -442,6 +677,53 @@ static PyObject* PyBobLearnLibsvmFile_read_all
     return 0;
   }
 
+  /** if neither was pre-allocated, both are allocated by readAll() **/
+  if (!labels && !values) {
+    try {
+      blitz::Array<int64_t,1> bzlab;
+      blitz::Array<double,2> bzval;
+      self->cxx->reset();
+      {
+        PyBobLearnLibsvm_NoGIL nogil; ///< arrays are local to this scope
+        self->cxx->readAll(bzlab, bzval);
+      }
+      labels = (PyBlitzArrayObject*)PyBlitzArrayCxx_NewFromArray(bzlab);
+      labels_ = make_xsafe(labels);
+      if (!labels) return 0;
+      values = (PyBlitzArrayObject*)PyBlitzArrayCxx_NewFromArray(bzval);
+      values_ = make_xsafe(values);
+      if (!values) return 0;
+    }
+    catch (std::exception& e) {
+      PyErr_SetString(PyExc_RuntimeError, e.what());
+      return 0;
+    }
+    catch (...) {
+      PyErr_Format(PyExc_RuntimeError, "%s cannot read data: unknown exception caught", Py_TYPE(self)->tp_name);
+      return 0;
+    }
+    Py_INCREF(labels);
+    Py_INCREF(values);
+    return Py_BuildValue("OO",
+        PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(labels)),
+        PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(values))
+        );
+  }
+
+  /** the file is scanned, if not done yet, for its shape and size **/
+  try {
+    PyBobLearnLibsvm_NoGIL nogil;
+    self->cxx->samples();
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot scan data: unknown exception caught", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
   if (labels && labels->shape[0] != (Py_ssize_t)self->cxx->samples()) {
     PyErr_Format(PyExc_RuntimeError, "1D `labels' array should have %" PY_FORMAT_SIZE_T "d elements matching the number of samples in this file, not %" PY_FORMAT_SIZE_T "d rows", self->cxx->samples(), labels->shape[0]);
     return 0;
@@ -475,20 +757,11 @@ static PyObject* PyBobLearnLibsvmFile_read_all
 
   /** all basic checks are done, can call the machine now **/
   try {
-    self->cxx->reset();
     auto bzlab = PyBlitzArrayCxx_AsBlitz<int64_t,1>(labels);
     auto bzval = PyBlitzArrayCxx_AsBlitz<double,2>(values);
-    blitz::Range all = blitz::Range::all();
-    int k = 0;
-
-    while ((self->cxx->good()) && ((size_t)k < self->cxx->samples())) {
-      blitz::Array<double,1> v_ = (*bzval)(k, all);
-
-      int label = 0;
-      bool ok = self->cxx->read_(label, v_);
-      if (ok) (*bzlab)(k) = label;
-      ++k;
-    }
+    self->cxx->reset();
+    PyBobLearnLibsvm_NoGIL nogil; ///< arrays are protected by this scope
+    self->cxx->readAll(*bzlab, *bzval);
   }
   catch (std::exception& e) {
     PyErr_SetString(PyExc_RuntimeError, e.what());
@@ -539,6 +812,18 @@ static PyMethodDef PyBobLearnLibsvmFile_methods[] = {
     METH_VARARGS|METH_KEYWORDS,
     s_read_doc
   },
+  {
+    s_read_sample_str,
+    (PyCFunction)PyBobLearnLibsvmFile_read_sample,
+    METH_VARARGS|METH_KEYWORDS,
+    s_read_sample_doc
+  },
+  {
+    s_read_samples_str,
+    (PyCFunction)PyBobLearnLibsvmFile_read_samples,
+    METH_VARARGS|METH_KEYWORDS,
+    s_read_samples_doc
+  },
   {
     s_read_all_str,
     (PyCFunction)PyBobLearnLibsvmFile_read_all,
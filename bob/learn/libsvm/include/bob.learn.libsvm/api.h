@@ -72,6 +72,7 @@ typedef struct {
 typedef struct {
   PyObject_HEAD
   bob::learn::libsvm::Machine* cxx;
+  Py_ssize_t predictions; ///< running without the GIL, changed with the GIL
 } PyBobLearnLibsvmMachineObject;
 
 #define PyBobLearnLibsvmMachine_Type_TYPE PyTypeObject
@@ -171,6 +172,30 @@ typedef struct {
 
   PyBobLearnLibsvm_CStringAsKernelType_RET PyBobLearnLibsvm_CStringAsKernelType PyBobLearnLibsvm_CStringAsKernelType_PROTO;
 
+  /**
+   * Releases the Python global interpreter lock (GIL) for as long as this
+   * object lives. Use it to wrap long-running computations that do not touch
+   * any Python object. The lock is re-acquired on destruction, including
+   * when an exception unwinds the stack.
+   */
+  class PyBobLearnLibsvm_NoGIL {
+
+    public:
+
+      PyBobLearnLibsvm_NoGIL(): m_state(PyEval_SaveThread()) {}
+
+      ~PyBobLearnLibsvm_NoGIL() { PyEval_RestoreThread(m_state); }
+
+    private:
+
+      PyBobLearnLibsvm_NoGIL(const PyBobLearnLibsvm_NoGIL&);
+
+      PyBobLearnLibsvm_NoGIL& operator= (const PyBobLearnLibsvm_NoGIL&);
+
+      PyThreadState* m_state;
+
+  };
+
 #else
 
   /* This section is used in modules that use `bob.learn.libsvm's' C-API */
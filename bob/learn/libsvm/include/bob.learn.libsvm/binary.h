@@ -0,0 +1,109 @@
+/**
+ * @date Fri 16 Oct 2026 21:07:12 CEST
+ *
+ * @brief A binary format for libsvm models, which can be memory-mapped and
+ * used without parsing
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#ifndef BOB_LEARN_LIBSVM_BINARY_H
+#define BOB_LEARN_LIBSVM_BINARY_H
+
+#include <string>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/shared_array.hpp>
+#include <blitz/array.h>
+#include <bob.learn.libsvm/machine.h>
+
+namespace bob { namespace learn { namespace libsvm {
+
+  /**
+   * Version of the binary format written by svm_write_binary(). Files of
+   * other versions are refused by svm_map_binary().
+   */
+  static const uint32_t BINARY_VERSION = 1;
+
+  /**
+   * A model in the binary format, as returned by svm_map_binary(). The
+   * arrays of floating point values point into the mapped file, which stays
+   * mapped as long as any of them, or the model, is referenced. The mapping
+   * is read-only: these arrays must not be written to.
+   */
+  struct binary_model {
+
+    /**
+     * The libsvm model. Class metadata, rho and probability parameters are
+     * copied, but rows of coefficients point into the file. Support vector
+     * nodes point into the file as well (with free_sv set to 0) if they
+     * were stored as such. Otherwise, they are null: support vectors are
+     * then only available as dense rows, in "sv".
+     */
+    boost::shared_ptr<svm_model> model;
+
+    size_t input_size; ///< number of dimensions of the support vectors
+    size_t stride; ///< elements between rows of "sv"
+    size_t nodes; ///< number of libsvm nodes, including terminators
+
+    /**
+     * Dense support vectors, one row of "input_size" values (padded with
+     * zeros to "stride") per support vector, starting at 64-byte
+     * boundaries. Null if support vectors were stored as nodes.
+     */
+    boost::shared_array<double> sv;
+
+    /**
+     * Coefficients of the support vectors, one row of "l" values per
+     * decision function a support vector is in, contiguous. Null if "sv"
+     * is.
+     */
+    boost::shared_array<double> sv_coef;
+
+    /**
+     * Squared norms of the dense support vectors. Null if "sv" is.
+     */
+    boost::shared_array<double> sv_norms;
+
+    blitz::Array<double,1> input_sub; ///< scaling: subtraction
+    blitz::Array<double,1> input_div; ///< scaling: division
+
+  };
+
+  /**
+   * Writes "model" to "filename" in the binary format, with the given input
+   * scaling, which should have at least "input_size" values. Support
+   * vectors are stored as dense rows, padded to "stride" elements, unless
+   * the model has a PRECOMPUTED kernel, has indices below 1, or is so
+   * sparse that these would take more space than libsvm's nodes, in which
+   * case nodes are stored. All blocks start at 64-byte boundaries. Values
+   * are written in the byte order of this machine, which is recorded in the
+   * header, as is the layout of libsvm's nodes: files can only be read on
+   * platforms sharing both.
+   */
+  void svm_write_binary(const std::string& filename, const svm_model* model,
+      size_t input_size, size_t stride,
+      const blitz::Array<double,1>& input_sub,
+      const blitz::Array<double,1>& input_div);
+
+  /**
+   * Tells if "filename" starts with the signature of the binary format
+   */
+  bool svm_is_binary(const std::string& filename);
+
+  /**
+   * Maps "filename", in the binary format, into memory and returns the model
+   * it holds. Only the header and the small arrays of the model are read:
+   * pages of the support vectors and coefficients are read by the operating
+   * system when first accessed, and shared between processes mapping the
+   * same file. Raises std::runtime_error if the file cannot be mapped, was
+   * written by another version of the format, or on an incompatible
+   * platform, if its blocks are inconsistent with its header, or if the
+   * indices of support vectors stored as nodes are negative, not
+   * increasing, or beyond the input size.
+   */
+  binary_model svm_map_binary(const std::string& filename);
+
+}}}
+
+#endif /* BOB_LEARN_LIBSVM_BINARY_H */
@@ -11,7 +11,12 @@
 #define BOB_LEARN_LIBSVM_FILE_H
 
 #include <blitz/array.h>
-#include <fstream>
+#include <stdint.h>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace boost { namespace interprocess { class mapped_region; } }
 
 namespace bob { namespace learn { namespace libsvm {
 
@@ -23,9 +28,17 @@ namespace bob { namespace learn { namespace libsvm {
    *
    * The labels are integer values, so are the indexes, starting from "1" (and
    * not from zero as a C-programmer would expect. The values are floating
-   * point.
+   * point, read in the "C" locale, whatever the locale of the process.
    *
    * Zero values are suppressed - this is a sparse format.
+   *
+   * The file is mapped into memory and parsed in place, without
+   * intermediate strings or streams. Its shape and number of samples are
+   * found by a light scan, which only reads indexes, when first needed. The
+   * scan records where each sample starts, so samples can then be read in
+   * any order, and readAll() parses them straight into its arrays. Both
+   * split the file in chunks of whole lines, scanned or parsed by concurrent
+   * threads (see setNumberOfThreads()).
    */
   class File {
 
@@ -44,15 +57,15 @@ namespace bob { namespace learn { namespace libsvm {
       /**
        * Returns the size of each entry in the file, in number of floats
        */
-      inline size_t shape() const { return m_shape; }
+      inline size_t shape() const { scan(); return m_shape; }
 
       /**
        * Returns the number of samples in the file.
        */
-      inline size_t samples() const { return m_n_samples; }
+      inline size_t samples() const { scan(); return m_offsets.size(); }
 
       /**
-       * Resets the file, going back to the beginning.
+       * Resets the file, so sequential reads start from its beginning again.
        */
       void reset();
 
@@ -69,6 +82,49 @@ namespace bob { namespace learn { namespace libsvm {
        */
       bool read_(int& label, blitz::Array<double,1>& values);
 
+      /**
+       * Reads all entries of the file. If both "labels" and "values" are
+       * empty, they are allocated with samples() and samples() x shape()
+       * elements, scanning the file first if needed. Otherwise, arrays must
+       * have these shapes already. Values are parsed straight into
+       * "values", without intermediate buffers. Sequential reads are not
+       * affected.
+       */
+      void readAll(blitz::Array<int64_t,1>& labels,
+          blitz::Array<double,2>& values) const;
+
+      /**
+       * Reads entry "index" of the file, which must be smaller than
+       * samples(). Sequential reads are not affected, and this method may
+       * be called from concurrent threads.
+       */
+      void read(size_t index, int& label,
+          blitz::Array<double,1>& values) const;
+
+      /**
+       * Reads as many consecutive entries as there are "labels", starting
+       * with entry "start", into "labels" and the rows of "values".
+       * Sequential reads are not affected, and this method may be called
+       * from concurrent threads.
+       */
+      void read(size_t start, blitz::Array<int64_t,1>& labels,
+          blitz::Array<double,2>& values) const;
+
+      /**
+       * Returns the number of threads used to scan the file and to read all
+       * of its entries. The default is read from the environment variable
+       * BOB_LEARN_LIBSVM_THREADS when the file is opened (1, if unset).
+       */
+      inline size_t getNumberOfThreads() const { return m_threads; }
+
+      /**
+       * Sets the number of threads used to scan the file and to read all of
+       * its entries. The file is split in chunks of whole lines, one per
+       * thread, so results are identical to those of a single-threaded run.
+       * Setting 0 selects the number of hardware threads available.
+       */
+      void setNumberOfThreads(size_t threads);
+
       /**
        * Returns the name of the file being read.
        */
@@ -77,16 +133,37 @@ namespace bob { namespace learn { namespace libsvm {
       /**
        * Tests if the file is still good to go.
        */
-      inline bool good() const { return m_file.good(); }
-      inline bool eof() const { return m_file.eof(); }
-      inline bool fail() const { return m_file.fail(); }
+      inline bool good() const { return !m_eof; }
+      inline bool eof() const { return m_eof; }
+      inline bool fail() const { return false; } ///< errors are raised
+
+    private: //methods
+
+      /**
+       * Finds the shape and number of samples of the file, if not known yet
+       */
+      void scan() const;
+
+      /**
+       * Parses entry "index" into "values", which has shape() elements,
+       * "stride" apart, and returns its label
+       */
+      int parse(size_t index, double* values, ptrdiff_t stride) const;
 
     private: //representation
 
       std::string m_filename; ///< The path to the file being read
-      std::ifstream m_file; ///< The file I'm reading.
-      size_t m_shape; ///< Number of floats in samples
-      size_t m_n_samples; ///< total number of samples at input file
+      boost::shared_ptr<boost::interprocess::mapped_region> m_region; ///< The file, mapped into memory, unless empty
+      const char* m_data; ///< Start of the file contents
+      const char* m_end; ///< End of the file contents
+      const char* m_next; ///< Start of the next line to read sequentially
+      size_t m_sample; ///< Number of samples read sequentially so far
+      bool m_eof; ///< If there are no samples left to read sequentially
+      size_t m_threads; ///< number of threads to scan or read all entries
+      mutable boost::mutex m_mutex; ///< protects the results of scans
+      mutable bool m_scanned; ///< If m_shape and m_offsets are known
+      mutable size_t m_shape; ///< Number of floats in samples
+      mutable std::vector<size_t> m_offsets; ///< Position of each sample
 
   };
 
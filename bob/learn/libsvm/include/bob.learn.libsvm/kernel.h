@@ -0,0 +1,71 @@
+/**
+ * @date Fri 16 Oct 2026 14:02:17 CEST
+ *
+ * @brief Vectorized primitives for the dense kernel evaluator
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#ifndef BOB_LEARN_LIBSVM_KERNEL_H
+#define BOB_LEARN_LIBSVM_KERNEL_H
+
+#include <cstddef>
+
+namespace bob { namespace learn { namespace libsvm {
+
+  /**
+   * Computes the dot product between "x" and each of the "rows" vectors
+   * stored, "stride" elements apart, from "y". Only the first "size"
+   * elements of each vector are used. Results are written to "output".
+   *
+   * The implementation is chosen once, at load time, depending on the
+   * instructions the CPU supports: AVX-512F, AVX2 (with FMA) or plain C++.
+   * Vectorized implementations accumulate partial sums in a different order
+   * than libsvm does, so results differ from those of svm_predict() by
+   * rounding only: the difference on each sum is bounded by about
+   * size * 2^-53 times the sum of the magnitudes of the products,
+   * |x[0]*y[0]| + ... + |x[size-1]*y[size-1]|. That is less than 1e-12 on
+   * typical decision values, but not relative to the result when products
+   * cancel out: RBF distances, computed from dot products by the dense
+   * evaluator, are summed again term by term when that happens. The scalar
+   * implementation reproduces libsvm's dot products exactly.
+   */
+  void dot(const double* x, const double* y, size_t stride, size_t rows,
+      size_t size, double* output);
+
+  /**
+   * Computes the dot products between each of the "rows" vectors stored,
+   * "x_stride" elements apart, from "x" and each of the "columns" vectors
+   * stored, "y_stride" elements apart, from "y". The result for row i and
+   * column j is written to output[i*output_stride + j]. This is a matrix
+   * product with "y" transposed, where columns are processed in tiles that
+   * stay in cache while blocks of 4 rows are run against them. Each of the
+   * results is computed exactly as dot() would, so it does not depend on
+   * how rows are split in blocks.
+   */
+  void dot(const double* x, size_t x_stride, size_t rows, const double* y,
+      size_t y_stride, size_t columns, size_t size, double* output,
+      size_t output_stride);
+
+  /**
+   * Single precision variants of the functions above. Vectors hold twice as
+   * many elements, but partial sums are rounded to float: the difference
+   * to a double precision sum is bounded by about size * 2^-24 times the sum
+   * of the magnitudes of the products.
+   */
+  void dot(const float* x, const float* y, size_t stride, size_t rows,
+      size_t size, float* output);
+
+  void dot(const float* x, size_t x_stride, size_t rows, const float* y,
+      size_t y_stride, size_t columns, size_t size, float* output,
+      size_t output_stride);
+
+  /**
+   * Returns the name of the instruction set used by the functions above:
+   * "avx512f", "avx2" or "scalar".
+   */
+  const char* instructionSet();
+
+}}}
+
+#endif /* BOB_LEARN_LIBSVM_KERNEL_H */
@@ -13,6 +13,7 @@
 
 #include <boost/shared_ptr.hpp>
 #include <boost/shared_array.hpp>
+#include <boost/function.hpp>
 #include <blitz/array.h>
 #include <fstream>
 #include <svm.h>
@@ -62,40 +63,31 @@ namespace bob { namespace learn { namespace libsvm {
     PRECOMPUTED
   }; /* kernel type used on the machine */
 
-    /**
-     * @brief Chooses the correct temporary directory to use, like this:
-     *
-     * - The environment variable TMPDIR, if it is defined. For security reasons
-     *   this only happens if the program is not SUID or SGID enabled.
-     * - The directory /tmp.
-     */
-    std::string _tmpdir();
-
-    /**
-     * @brief Returns the full path of a temporary file in tmpdir().
-     *
-     * @param extension The desired extension for the file
-     */
-    std::string _tmpfile(const std::string& extension=".hdf5");
+  struct binary_model; ///< see binary.h
 
 
   /**
-   * Here is the problem: libsvm does not provide a simple way to extract the
-   * information from the SVM structure. There are lots of cases and allocation
-   * and re-allocation is not exactly trivial. To overcome these problems and
-   * still be able to save data in HDF5 format, we let libsvm pickle the data
-   * into a text file and then re-read it in binary. We save the outcome of
-   * this readout in a binary blob inside the HDF5 file.
+   * Pickles the model in libsvm's text format, in memory (see svm_format()),
+   * as earlier versions saved it, as a binary blob, inside HDF5 files. Such
+   * files are still read by Machine, but models are now saved as typed
+   * datasets (see svm_write_hdf5()). No temporary files are involved.
    */
   blitz::Array<uint8_t,1> svm_pickle(const boost::shared_ptr<svm_model> model);
 
   /**
-   * Reverts the pickling process, returns the model
+   * Reverts the pickling process, returns the model (see svm_parse())
    */
   boost::shared_ptr<svm_model> svm_unpickle(const blitz::Array<uint8_t,1>& buffer);
 
   /**
    * Interface to svm_model, from libsvm. Incorporates prediction.
+   *
+   * Thread safety: all const prediction methods (predictClass*() and their
+   * batch variants) keep their scratch memory per calling thread and never
+   * modify the machine. They may be called concurrently on the same object,
+   * so a single loaded model can serve any number of worker threads. Methods
+   * that change the machine (e.g. setInputSubtraction()) must not run while
+   * predictions are in progress.
    */
   class Machine {
 
@@ -108,6 +100,12 @@ namespace bob { namespace learn { namespace libsvm {
        * parameters will be set to defaults (subtraction of 0.0 and division by
        * 1.0). If you need scaling to be applied, set it individually using the
        * appropriate methods bellow.
+       *
+       * Files written by saveBinary() are recognized by their signature and
+       * memory-mapped instead (see svm_map_binary()): nothing is parsed, the
+       * scaling parameters are loaded as well and dense support vectors are
+       * used from the file, as they are, so loading takes about the same
+       * time for models of any size.
        */
       Machine(const std::string& model_file);
 
@@ -115,7 +113,9 @@ namespace bob { namespace learn { namespace libsvm {
        * Builds a new Support Vector Machine from an HDF5 file containing the
        * configuration for this machine. Scaling parameters are also loaded
        * from the file. Using this constructor assures a 100% state recovery
-       * from previous sessions.
+       * from previous sessions. The model is read from the typed datasets
+       * written by save() (see svm_read_hdf5()), or from the text blob that
+       * earlier versions wrote.
        */
       Machine(bob::io::base::HDF5File& config);
 
@@ -123,12 +123,19 @@ namespace bob { namespace learn { namespace libsvm {
        * Builds a new SVM model from a trained model. Scaling parameters will
        * be neutral (subtraction := 0.0, division := 1.0).
        *
+       * The support vector nodes of "model" are left untouched, unless
+       * "owned" is set: the caller then guarantees nobody else uses the
+       * model, and that its nodes were allocated in a single block, starting
+       * at SV[0], as libsvm's loader does. Only then may this machine release
+       * them in the compact layout, which is otherwise not available (see
+       * setCompact()).
+       *
        * @note: This method is typically only used by the respective
        * bob::trainer::MachineTrainer as it requires the creation of the
        * object "svm_model". You can still make use of it if you decide to
        * implement the model instantiation yourself.
        */
-      Machine(boost::shared_ptr<svm_model> model);
+      Machine(boost::shared_ptr<svm_model> model, bool owned=false);
 
       /**
        * Virtual d'tor
@@ -215,7 +222,8 @@ namespace bob { namespace learn { namespace libsvm {
       /**
        * Sets all input subtraction values to a specific value.
        */
-      inline void setInputSubtraction(double v) { m_input_sub = v; }
+      inline void setInputSubtraction(double v)
+      { m_input_sub = v; updateScaling(); }
 
       /**
        * Returns the input division factor
@@ -233,7 +241,209 @@ namespace bob { namespace learn { namespace libsvm {
       /**
        * Sets all input division values to a specific value.
        */
-      inline void setInputDivision(double v) { m_input_div = v; }
+      inline void setInputDivision(double v)
+      { m_input_div = v; updateScaling(); }
+
+      /**
+       * Returns the number of threads used by the batch prediction methods.
+       * The default is read from the environment variable
+       * BOB_LEARN_LIBSVM_THREADS when the machine is created (1, if unset).
+       */
+      inline size_t getNumberOfThreads() const { return m_threads; }
+
+      /**
+       * Sets the number of threads used by the batch prediction methods.
+       * Rows of the input are split in contiguous blocks, one per thread, so
+       * results are identical to those of a single-threaded run. Setting 0
+       * selects the number of hardware threads available.
+       */
+      void setNumberOfThreads(size_t threads);
+
+      /**
+       * Returns how many times prediction methods allocated memory from the
+       * heap since the library was loaded, summed over all threads. Working
+       * memory is private to each thread and kept between calls, so this
+       * counter stops growing once every thread has served its largest
+       * request: single predictions, in particular, do not allocate at all
+       * after the first one. Batch predictions over several threads run on
+       * the persistent pool of parallelFor(), whose threads keep their
+       * working memory as well. Each evaluation by libsvm itself, as for
+       * machines that are not dense, counts as one allocation, since libsvm
+       * allocates its own working memory. Memory allocated on behalf of
+       * predictions elsewhere, e.g. output arrays created by bindings, is
+       * counted through countAllocations().
+       */
+      static size_t allocations();
+
+      /**
+       * Adds "count" to the counter returned by allocations()
+       */
+      static void countAllocations(size_t count=1);
+
+      /**
+       * Tells if class-only predictions of multi-class machines stop voting
+       * early. See setEarlyVoting().
+       */
+      inline bool isEarlyVoting() const { return m_early; }
+
+      /**
+       * Switches early voting on or off. When on, predictClass() and
+       * predictClassBatch() of C_SVC and NU_SVC machines with more than 2
+       * classes, evaluated with dense support vectors or collapsed weight
+       * vectors, evaluate the one-vs-one decision functions on demand: all
+       * pending ones of a candidate class first, then of the class that
+       * could still get the most votes, until no class can catch up with
+       * the leader. Decision values are computed exactly as for the other
+       * methods, and ties go to the lowest class index as in a full vote,
+       * so labels are identical. On by default.
+       */
+      inline void setEarlyVoting(bool early) { m_early = early; }
+
+      /**
+       * Tells if predictions use the dense representation of the support
+       * vectors, built by this machine, instead of libsvm's own evaluator.
+       */
+      inline bool isDense() const
+      { return m_sv.get() != 0 || isQuantized(); }
+
+      /**
+       * Switches the dense representation of the support vectors on or off.
+       * When on, support vectors are kept in a row-major matrix, with rows
+       * aligned to cache lines, and kernels are evaluated without walking
+       * libsvm's sparse nodes, using the vectorized primitives of kernel.h.
+       * The squared norms of the support vectors are stored as well, so RBF
+       * kernels cost one dot product per support vector. Results match
+       * libsvm's up to the rounding differences documented there. This is
+       * the default, unless the model is so sparse that the dense matrix
+       * would take more memory than the original support vectors. Models
+       * with PRECOMPUTED kernels, or with support vector indices below 1,
+       * cannot be switched on. Support vectors are quantized if so set (see
+       * setQuantization()).
+       */
+      void setDense(bool dense);
+
+      /**
+       * Tells if libsvm's own copy of the support vectors was released. See
+       * setCompact().
+       */
+      inline bool isCompact() const { return m_released; }
+
+      /**
+       * Switches the compact layout on or off. When on, the dense support
+       * vectors become the only copy of the support vectors: libsvm's
+       * nodes, which take 16 bytes per non-zero value (an index and the
+       * value) plus a terminator per support vector, are released. They
+       * are rebuilt from the dense support vectors, on a temporary basis,
+       * when the machine is saved, and for good if the representation
+       * changes (see setDense(), setCollapsed() and setQuantization()).
+       * This is the default for dense models loaded or trained with this
+       * package, which own their nodes, but not for models given to the
+       * constructor by others. It requires the dense
+       * representation to be active, but not collapsed, and probabilities,
+       * if any, to be computed by this machine (see computesProbability()).
+       * Compacting a quantized machine discards the exact support vectors:
+       * they are rebuilt from their codes and quantizationError() is no
+       * longer available.
+       */
+      void setCompact(bool compact);
+
+      /**
+       * Tells if the dense support vectors are stored as integer codes. See
+       * setQuantization().
+       */
+      inline bool isQuantized() const
+      { return m_sv_q8.get() != 0 || m_sv_q16.get() != 0; }
+
+      /**
+       * Returns the number of bits of the integer codes the dense support
+       * vectors are stored as, or 0 if they are not quantized.
+       */
+      size_t quantization() const;
+
+      /**
+       * Stores the dense support vectors as 8 or 16-bit integer codes, or as
+       * doubles if "bits" is 0. Values of every dimension are mapped
+       * linearly from their range over all support vectors to codes in
+       * [-127, 127] (or [-32767, 32767]), with one scale and offset per
+       * dimension. With d dimensions, each support vector then takes d (or
+       * 2d) bytes, instead of 8d. Kernels are evaluated on the decoded
+       * support vectors, one tile at a time, as x.offset + (scale*x).code,
+       * so inputs are multiplied by the scales once and codes only need to
+       * be converted; the squared norms of the decoded support vectors are
+       * stored for RBF kernels. Decision values differ from the exact ones
+       * by an amount that depends on the model: see quantizationError().
+       * The setting follows later changes of the dense representation, but
+       * requires it to be active (see setDense()). Off by default. Switching
+       * it on turns the compact layout off (see setCompact()), so that
+       * libsvm's nodes keep the exact support vectors.
+       */
+      void setQuantization(size_t bits);
+
+      /**
+       * Measures the effect of quantization on a calibration set: evaluates
+       * every row of "input" with the quantized support vectors and with
+       * libsvm, writes to "errors" the largest absolute difference between
+       * the decision values of each row, and returns the number of rows
+       * whose predicted label differs. "errors" should have as many
+       * positions as there are rows in "input". Throws if the support
+       * vectors are not quantized, or if the exact ones were released.
+       */
+      size_t quantizationError(const blitz::Array<double,2>& input,
+          blitz::Array<double,1>& errors) const;
+
+      /**
+       * Tells if predictions use one weight vector per decision function,
+       * instead of evaluating the kernel on every support vector. This is
+       * only possible with LINEAR kernels.
+       */
+      inline bool isCollapsed() const { return m_weights.get() != 0; }
+
+      /**
+       * Switches the collapsed representation of LINEAR models on or off.
+       * With a LINEAR kernel, each decision function is the dot product of
+       * the input with the weighted sum of its support vectors, minus rho.
+       * When on, these sums are computed once and predictions cost one dot
+       * product per decision function, whatever the number of support
+       * vectors. The input scaling is folded into the weights and biases, so
+       * inputs are not normalized at prediction time. Decision values differ
+       * from libsvm's by rounding only. This is the default for LINEAR
+       * models, for which the dense support vectors are then not built.
+       * Other kernels cannot be switched on.
+       */
+      void setCollapsed(bool collapsed);
+
+      /**
+       * Returns the weight vectors of a LINEAR model, one row per decision
+       * function, in the order libsvm reports decision values. Each decision
+       * value is the dot product between the scaled input and a row, minus
+       * the matching rho. Throws if the kernel is not LINEAR.
+       */
+      blitz::Array<double,2> getWeights() const;
+
+      /**
+       * Tells if predictions run in single precision. See
+       * setSinglePrecision().
+       */
+      inline bool isSinglePrecision() const
+      { return m_single && (isDense() || isCollapsed()); }
+
+      /**
+       * Switches single precision inference on or off. When on, the dense
+       * support vectors, their coefficients and norms (or, for collapsed
+       * models, the weight vectors) are kept as float, and so are the
+       * scaled inputs and kernel values: memory traffic is halved and
+       * vectorized dot products process twice as many elements per
+       * instruction. Decision values are returned as double, but are only
+       * accurate to about 1e-5 relative to their magnitude; on the bundled
+       * heart and iris models, predicted labels do not change and scores
+       * and probabilities stay within 1e-4 of the double precision ones.
+       * The setting follows later changes of representation (see
+       * setDense() and setCollapsed()), but requires one of them to be
+       * active: it cannot be switched on for models evaluated by libsvm.
+       * Quantized support vectors (see setQuantization()) are then decoded
+       * to float. Off by default.
+       */
+      void setSinglePrecision(bool single);
 
       /**
        * Predict, output classes only. Note that the number of labels in the
@@ -249,6 +459,13 @@ namespace bob { namespace learn { namespace libsvm {
        */
       int predictClass_(const blitz::Array<double,1>& input) const;
 
+      /**
+       * Same as above, for single precision inputs. These are converted
+       * while being scaled, without intermediate copies. The same holds for
+       * the other unchecked methods taking float inputs, below.
+       */
+      int predictClass_(const blitz::Array<float,1>& input) const;
+
       /**
        * Predicts class and scores output for each class on this SVM,
        *
@@ -266,6 +483,10 @@ namespace bob { namespace learn { namespace libsvm {
         (const blitz::Array<double,1>& input,
          blitz::Array<double,1>& scores) const;
 
+      int predictClassAndScores_
+        (const blitz::Array<float,1>& input,
+         blitz::Array<double,1>& scores) const;
+
       /**
        * Predict, output class and probabilities for each class on this SVM,
        * but only if the model supports it. Otherwise, throws a run-time
@@ -286,6 +507,169 @@ namespace bob { namespace learn { namespace libsvm {
         (const blitz::Array<double,1>& input,
          blitz::Array<double,1>& probabilities) const;
 
+      int predictClassAndProbabilities_
+        (const blitz::Array<float,1>& input,
+         blitz::Array<double,1>& probabilities) const;
+
+      /**
+       * Predicts the class of every row in the input matrix, in a single
+       * call. The output array "labels" should have as many positions as
+       * there are rows in "input".
+       *
+       * Prefer this method to looping over predictClass() when scoring many
+       * samples: the per-call setup is only paid once for the whole block.
+       */
+      void predictClassBatch
+        (const blitz::Array<double,2>& input,
+         blitz::Array<int64_t,1>& labels) const;
+
+      /**
+       * Predicts the class of every row in the input matrix. Same as above,
+       * but does not check
+       */
+      void predictClassBatch_
+        (const blitz::Array<double,2>& input,
+         blitz::Array<int64_t,1>& labels) const;
+
+      void predictClassBatch_
+        (const blitz::Array<float,2>& input,
+         blitz::Array<int64_t,1>& labels) const;
+
+      /**
+       * Predicts class and scores for every row in the input matrix. The
+       * "scores" array should have as many rows as "input" and as many
+       * columns as combinations of classes 2-by-2 (or 1 column, for binary
+       * problems). Kernels are evaluated for blocks of rows at once (see
+       * decideBlock()), giving the same scores as predictClassAndScores()
+       * on each of the rows.
+       *
+       * Note: The scores array must be lying on contiguous memory. This is
+       * also checked.
+       */
+      void predictClassAndScoresBatch
+        (const blitz::Array<double,2>& input,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& scores) const;
+
+      /**
+       * Predicts class and scores for every row in the input matrix. Same as
+       * above, but does not check
+       */
+      void predictClassAndScoresBatch_
+        (const blitz::Array<double,2>& input,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& scores) const;
+
+      void predictClassAndScoresBatch_
+        (const blitz::Array<float,2>& input,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& scores) const;
+
+      /**
+       * Predicts class and probabilities for every row in the input matrix,
+       * but only if the model supports it. Otherwise, throws a run-time
+       * exception. The "probabilities" array should have as many rows as
+       * "input" and as many columns as classes.
+       *
+       * Note: The probabilities array must be lying on contiguous memory.
+       * This is also checked.
+       */
+      void predictClassAndProbabilitiesBatch
+        (const blitz::Array<double,2>& input,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& probabilities) const;
+
+      /**
+       * Predicts class and probabilities for every row in the input matrix.
+       * Same as above, but does not check
+       */
+      void predictClassAndProbabilitiesBatch_
+        (const blitz::Array<double,2>& input,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& probabilities) const;
+
+      void predictClassAndProbabilitiesBatch_
+        (const blitz::Array<float,2>& input,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& probabilities) const;
+
+      /**
+       * Predicts the class of every row of a sparse matrix in compressed
+       * sparse row (CSR) format, as used by scipy.sparse.csr_matrix: the
+       * non-zero values of row k are values(indptr(k)) up to
+       * values(indptr(k+1)-1), at the 0-based columns given by the same
+       * positions of "indices", which must increase strictly within each
+       * row. "indptr" has one more position than "labels". Columns from
+       * inputSize() on are ignored, as extra columns of dense inputs are.
+       *
+       * Rows are not densified: libsvm is handed their non-zero values, and
+       * collapsed models (see setCollapsed()) only read their weight vectors
+       * at these columns. Exceptions are machines evaluated with dense
+       * support vectors (see setDense()), which scatter rows into blocks of
+       * dense ones, and a non-zero input subtraction (see
+       * setInputSubtraction()), which makes missing values non-zero.
+       */
+      void predictClassBatch
+        (const blitz::Array<int64_t,1>& indptr,
+         const blitz::Array<int64_t,1>& indices,
+         const blitz::Array<double,1>& values,
+         blitz::Array<int64_t,1>& labels) const;
+
+      /**
+       * Predicts the class of every row of a sparse matrix. Same as above,
+       * but does not check
+       */
+      void predictClassBatch_
+        (const blitz::Array<int64_t,1>& indptr,
+         const blitz::Array<int64_t,1>& indices,
+         const blitz::Array<double,1>& values,
+         blitz::Array<int64_t,1>& labels) const;
+
+      /**
+       * Predicts class and scores for every row of a sparse matrix in CSR
+       * format (see above). The "scores" array is as for dense inputs.
+       */
+      void predictClassAndScoresBatch
+        (const blitz::Array<int64_t,1>& indptr,
+         const blitz::Array<int64_t,1>& indices,
+         const blitz::Array<double,1>& values,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& scores) const;
+
+      /**
+       * Predicts class and scores for every row of a sparse matrix. Same as
+       * above, but does not check
+       */
+      void predictClassAndScoresBatch_
+        (const blitz::Array<int64_t,1>& indptr,
+         const blitz::Array<int64_t,1>& indices,
+         const blitz::Array<double,1>& values,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& scores) const;
+
+      /**
+       * Predicts class and probabilities for every row of a sparse matrix in
+       * CSR format (see above), but only if the model supports it. The
+       * "probabilities" array is as for dense inputs.
+       */
+      void predictClassAndProbabilitiesBatch
+        (const blitz::Array<int64_t,1>& indptr,
+         const blitz::Array<int64_t,1>& indices,
+         const blitz::Array<double,1>& values,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& probabilities) const;
+
+      /**
+       * Predicts class and probabilities for every row of a sparse matrix.
+       * Same as above, but does not check
+       */
+      void predictClassAndProbabilitiesBatch_
+        (const blitz::Array<int64_t,1>& indptr,
+         const blitz::Array<int64_t,1>& indices,
+         const blitz::Array<double,1>& values,
+         blitz::Array<int64_t,1>& labels,
+         blitz::Array<double,2>& probabilities) const;
+
       /**
        * Saves the current model state to a file. With this variant, the model
        * is saved on simpler libsvm model file that does not include the
@@ -296,10 +680,20 @@ namespace bob { namespace learn { namespace libsvm {
       /**
        * Saves the whole machine into a configuration file. This allows for a
        * single instruction parameter loading, which includes both the model
-       * and the scaling parameters.
+       * and the scaling parameters. The model is stored as typed datasets,
+       * see svm_write_hdf5().
        */
       void save(bob::io::base::HDF5File& config) const;
 
+      /**
+       * Saves the whole machine, including the scaling parameters, to a file
+       * in the binary format of svm_write_binary(), which the constructor
+       * taking a file name maps into memory. Support vectors are stored as
+       * this machine uses them by default: as dense rows, unless the model is
+       * very sparse or has a PRECOMPUTED kernel.
+       */
+      void saveBinary(const std::string& filename) const;
+
     private: //not implemented
 
       Machine(const Machine& other);
@@ -313,13 +707,220 @@ namespace bob { namespace learn { namespace libsvm {
        */
       void reset();
 
+      /**
+       * Sets the input size and resets all settings of this machine to their
+       * defaults. Called by reset() and load(), before the representation
+       * of the support vectors is built.
+       */
+      void initialize(size_t input_size);
+
+      /**
+       * Sets this machine up from a model mapped by svm_map_binary(): uses
+       * its dense support vectors as they are, if any, and its scaling.
+       */
+      void load(const binary_model& binary);
+
+      /**
+       * Refreshes the values derived from the input scaling: reciprocals of
+       * the division factors and, for collapsed models, the weight vectors
+       * and biases, into which the scaling is folded. Called every time the
+       * scaling changes.
+       */
+      void updateScaling();
+
+      /**
+       * Tells if libsvm's nodes may be released, see setCompact()
+       */
+      bool releasable() const;
+
+      /**
+       * Releases libsvm's nodes, if the compact layout was requested and is
+       * possible. Called after every change of representation.
+       */
+      void releaseNodes();
+
+      /**
+       * Rebuilds libsvm's nodes from the dense support vectors, if they
+       * were released. Called before every change of representation.
+       */
+      void restoreNodes();
+
+      /**
+       * Allocates libsvm nodes holding the non-zero values of the dense
+       * support vectors, as a single block obtained with malloc() (as libsvm
+       * does), and points "sv" to the nodes of every support vector.
+       */
+      void buildNodes(svm_node** sv) const;
+
+      /**
+       * Returns the libsvm model, with its nodes rebuilt on a temporary
+       * copy if they were released
+       */
+      boost::shared_ptr<svm_model> nodeModel() const;
+
+      /**
+       * Refreshes the single precision copies of the dense support vectors
+       * or of the collapsed weights, or releases them if single precision
+       * is off. Called every time one of the double precision versions
+       * changes.
+       */
+      void updatePrecision();
+
+      /**
+       * Scales "rows" inputs, read from "input" ("row_stride" elements
+       * apart, with "stride" elements between their components), evaluates
+       * their kernels against the dense support vectors and writes their
+       * decision values, one row per input, to "dec_values". Kernels of all
+       * rows are computed by a single matrix product with the support
+       * vectors. For RBF kernels, squared distances are obtained as
+       * ||x||^2 + ||sv||^2 - 2 x.sv, with ||sv||^2 precomputed by
+       * setDense(), so that only dot products are needed per support vector.
+       * On multi-class problems, the kernel values of each class block are
+       * multiplied at once by the coefficients of all decision functions
+       * the class takes part in. Runs in single precision, or on quantized
+       * support vectors, if so set.
+       *
+       * This and the other private methods templated on "I" read inputs of
+       * type double or float, only instantiated by the implementation.
+       */
+      template <typename I>
+      void decideBlock(const I* input, ptrdiff_t row_stride,
+          ptrdiff_t stride, size_t rows, double* dec_values) const;
+
+      /**
+       * Returns the predicted label (or the output, for regression) given
+       * the decision values of an input.
+       */
+      double vote(const double* dec_values) const;
+
+      /**
+       * Tells if class-only predictions use early voting, see
+       * setEarlyVoting()
+       */
+      bool votesEarly() const;
+
+      /**
+       * Predicts the labels of "rows" inputs with early voting, see
+       * setEarlyVoting(). Inputs are evaluated together as by decideBlock().
+       */
+      template <typename I>
+      void classifyBlock(const I* input, ptrdiff_t row_stride,
+          ptrdiff_t stride, size_t rows, double* labels) const;
+
+      /**
+       * Scales the input (read with "stride" between elements) and
+       * evaluates it, as svm_predict_values() does: writes the values of the
+       * decision functions in "dec_values" and returns the predicted label
+       * (or the output, for regression).
+       */
+      template <typename I>
+      double predictValues(const I* input, ptrdiff_t stride,
+          double* dec_values) const;
+
+      /**
+       * Same as predictValues(), but without the decision values.
+       */
+      template <typename I>
+      double predict(const I* input, ptrdiff_t stride) const;
+
+      /**
+       * Scales the input and evaluates it, as svm_predict_probability()
+       * does: writes the probability of every class in "prob_estimates" and
+       * returns the predicted label.
+       */
+      template <typename I>
+      double predictProbability(const I* input, ptrdiff_t stride,
+          double* prob_estimates) const;
+
+      /**
+       * Tells if probabilities are computed by this machine, from decision
+       * values, instead of being delegated to libsvm.
+       */
+      bool computesProbability() const;
+
+      /**
+       * Computes the probability of every class from the decision values of
+       * an input, as svm_predict_probability() does, and returns the
+       * predicted label. Only valid if computesProbability() is true.
+       */
+      double probability(const double* dec_values,
+          double* prob_estimates) const;
+
+      /**
+       * Computes the decision values of every row of "input", splitting
+       * rows over the configured number of threads, and calls "f" with the
+       * row number, the predicted label and the decision values of each.
+       * With dense support vectors, rows are evaluated in blocks, so that
+       * kernels are computed by matrix products (see decideBlock()). If
+       * "values" is false, only labels are needed: "f" may then be called
+       * with null decision values, if these are not all computed (see
+       * setEarlyVoting()).
+       */
+      template <typename I>
+      void forEachDecision(const blitz::Array<I,2>& input,
+          const boost::function<void (size_t, double, const double*)>& f,
+          bool values=true) const;
+
+      /**
+       * Implements the unchecked batch prediction methods: writes the label
+       * of every row of "input" and, if not null, its scores or its
+       * probabilities.
+       */
+      template <typename I>
+      void predictBatch(const blitz::Array<I,2>& input,
+          blitz::Array<int64_t,1>& labels, blitz::Array<double,2>* scores,
+          blitz::Array<double,2>* probabilities) const;
+
+      /**
+       * Predicts the label of a sparse input, with "size" non-zero values at
+       * the 0-based columns "index", without the dense evaluator. Writes its
+       * decision values or, if "prob_estimates" is not null, its
+       * probabilities. "shifted" tells if the input subtraction is not zero.
+       */
+      double predictSparse(const int64_t* index, const double* value,
+          size_t size, bool shifted, double* dec_values,
+          double* prob_estimates) const;
+
+      /**
+       * Implements the unchecked batch prediction methods for sparse inputs,
+       * as predictBatch() does for dense ones
+       */
+      void predictSparseBatch(const blitz::Array<int64_t,1>& indptr,
+          const blitz::Array<int64_t,1>& indices,
+          const blitz::Array<double,1>& values,
+          blitz::Array<int64_t,1>& labels, blitz::Array<double,2>* scores,
+          blitz::Array<double,2>* probabilities) const;
+
     private: //representation
 
       boost::shared_ptr<svm_model> m_model; ///< libsvm model pointer
-      mutable boost::shared_array<svm_node> m_input_cache; ///< cache
       size_t m_input_size; ///< vector size expected as input for the SVM's
       blitz::Array<double,1> m_input_sub; ///< scaling: subtraction
       blitz::Array<double,1> m_input_div; ///< scaling: division
+      blitz::Array<double,1> m_input_mul; ///< scaling: 1/m_input_div
+      bool m_input_scaled; ///< false if scaling does not change the input
+      size_t m_threads; ///< number of threads for batch prediction
+      bool m_early; ///< early voting for class-only predictions
+      boost::shared_array<double> m_sv; ///< dense support vectors
+      size_t m_stride; ///< input size, padded to a whole cache line
+      boost::shared_array<double> m_sv_coef; ///< coefficients, contiguous
+      boost::shared_array<double> m_sv_norms; ///< squared norms of m_sv
+      boost::shared_array<double> m_weights; ///< collapsed LINEAR model
+      boost::shared_array<double> m_bias; ///< rho, for m_weights
+      bool m_single; ///< if single precision inference was requested
+      size_t m_fstride; ///< input size, padded to a whole line of floats
+      boost::shared_array<float> m_sv_f; ///< m_sv, in single precision
+      boost::shared_array<float> m_sv_coef_f; ///< m_sv_coef, as float
+      boost::shared_array<float> m_sv_norms_f; ///< norms of m_sv_f
+      boost::shared_array<float> m_weights_f; ///< m_weights, as float
+      size_t m_bits; ///< requested quantization of the support vectors
+      boost::shared_array<int8_t> m_sv_q8; ///< 8-bit support vector codes
+      boost::shared_array<int16_t> m_sv_q16; ///< 16-bit support vector codes
+      boost::shared_array<double> m_sv_scale; ///< quantization step
+      boost::shared_array<double> m_sv_offset; ///< value of code 0
+      bool m_owned; ///< if nobody else uses the nodes of m_model
+      bool m_compact; ///< if the compact layout was requested
+      bool m_released; ///< if libsvm's nodes were released
 
   };
 
@@ -0,0 +1,83 @@
+/**
+ * @date Fri 16 Oct 2026 19:20:44 CEST
+ *
+ * @brief Reading and writing libsvm models in memory, in libsvm's text
+ * format, and as structured HDF5 datasets
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#ifndef BOB_LEARN_LIBSVM_MODEL_H
+#define BOB_LEARN_LIBSVM_MODEL_H
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include <bob.learn.libsvm/machine.h>
+
+namespace bob { namespace learn { namespace libsvm {
+
+  /**
+   * Returns "model" in libsvm's text format, as svm_save_model() writes it
+   * to a file: floating point parameters and coefficients with 17
+   * significant digits, support vector values with 8. Output does not depend
+   * on the current locale.
+   */
+  std::string svm_format(const svm_model* model);
+
+  /**
+   * Reads a model in libsvm's text format from the "size" bytes at "data",
+   * as svm_load_model() reads it from a file. The model is allocated as
+   * libsvm's loader does, with all support vector nodes in a single block,
+   * and is released by libsvm when the returned pointer goes out of scope.
+   * Numbers are read in the "C" locale, whatever the current one, as
+   * svm_load_model() does. Raises std::runtime_error if the text is not a
+   * valid model, including support vectors with negative indices.
+   *
+   * Support vectors are parsed on up to "threads" threads, each taking a
+   * chunk of whole lines of at least 1 MiB: a first pass counts the lines
+   * and ':' of every chunk, which tells where its support vectors and
+   * nodes start, then chunks are parsed independently. The model does not
+   * depend on the number of threads.
+   */
+  boost::shared_ptr<svm_model> svm_parse(const char* data, size_t size,
+      size_t threads=1);
+
+  /**
+   * Writes "model" to the current group of "config", as typed datasets:
+   *
+   * - "svm_type", "kernel_type", "degree" (int64 scalars), "gamma" and
+   *   "coef0" (float64 scalars), the parameters of the kernel;
+   * - "nr_class" and "total_sv" (int64 scalars);
+   * - "rho", "probA", "probB" (float64, one per pair of classes) and
+   *   "prob_density_marks" (float64), the latter three only if the model
+   *   has them;
+   * - "label" and "nSV" (int64, one per class), if the model has them;
+   * - "sv_coef" (float64, nr_class-1 rows of total_sv coefficients);
+   * - the support vectors, either dense, as "support_vectors" (float64,
+   *   one row per support vector, with as many columns as the largest
+   *   index of their values), or in compressed sparse row format, as
+   *   "sv_indptr", "sv_indices" (int64) and "sv_values" (float64): values
+   *   of support vector k are at positions sv_indptr[k] to sv_indptr[k+1]-1
+   *   of the last two, with libsvm's own, 1-based, indices. Models with
+   *   PRECOMPUTED kernels or indices below 1, and models so sparse that
+   *   dense support vectors would take more space, are stored in the
+   *   latter format.
+   *
+   * Arrays with no elements are not written.
+   */
+  void svm_write_hdf5(bob::io::base::HDF5File& config,
+      const svm_model* model);
+
+  /**
+   * Reads a model written by svm_write_hdf5() from the current group of
+   * "config", directly into memory allocated as libsvm's loader does (see
+   * svm_parse()). Raises std::runtime_error if the datasets are
+   * inconsistent, if classifiers (C_SVC and NU_SVC) lack "label" or "nSV",
+   * if "nSV" does not sum to "total_sv", or if the indices of a support
+   * vector are negative or not increasing.
+   */
+  boost::shared_ptr<svm_model> svm_read_hdf5(bob::io::base::HDF5File& config);
+
+}}}
+
+#endif /* BOB_LEARN_LIBSVM_MODEL_H */
@@ -0,0 +1,25 @@
+/**
+ * @date Sat 17 Oct 2026 09:41:05 CEST
+ *
+ * @brief Parsing of numbers in text files, whatever the locale
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#ifndef BOB_LEARN_LIBSVM_NUMBER_H
+#define BOB_LEARN_LIBSVM_NUMBER_H
+
+namespace bob { namespace learn { namespace libsvm {
+
+  /**
+   * Reads a floating-point number at "p", as strtod() does in the "C"
+   * locale: the decimal separator is always '.', whatever the locale of the
+   * process (e.g., set from Python with locale.setlocale()). libsvm writes
+   * and reads its files in the "C" locale. Sets "*end" past the last
+   * character read, or to "p" if there is no number. Thread-safe.
+   */
+  double parseDouble(const char* p, char** end);
+
+}}}
+
+#endif /* BOB_LEARN_LIBSVM_NUMBER_H */
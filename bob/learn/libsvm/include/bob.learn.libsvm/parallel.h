@@ -0,0 +1,56 @@
+/**
+ * @date Fri 16 Oct 2026 10:12:31 CEST
+ *
+ * @brief Minimal helpers to split work over a number of threads
+ *
+ * Copyright (C) 2011-2014 Idiap Research Institute, Martigny, Switzerland
+ */
+
+#ifndef BOB_LEARN_LIBSVM_PARALLEL_H
+#define BOB_LEARN_LIBSVM_PARALLEL_H
+
+#include <cstddef>
+#include <boost/function.hpp>
+
+namespace bob { namespace learn { namespace libsvm {
+
+  /**
+   * Returns the default number of worker threads, read from the environment
+   * variable BOB_LEARN_LIBSVM_THREADS. If that variable is not set or is not
+   * a positive integer, returns 1 (i.e., work is done on the calling thread).
+   * Setting it to "0" selects the number of hardware threads available.
+   */
+  size_t defaultThreads();
+
+  /**
+   * Splits the range [0, size) into, at most, "threads" contiguous chunks of
+   * at least "grain" elements and calls f(start, end) once per chunk, each
+   * chunk on its own thread. The calling thread processes the first chunk,
+   * the others run on a pool of threads shared by all calls, which is grown
+   * to the largest "threads" - 1 requested and kept until the process exits.
+   * Children of fork(), which inherit none of these threads, start a pool of
+   * their own.
+   * Chunk k always runs on the same thread of the pool, so thread-local
+   * memory used by "f" is reused by the next call of the same size.
+   * Returns when all chunks are done. If any call to "f" throws, the first
+   * exception caught is re-thrown on the calling thread. Calls made from
+   * within a chunk run serially.
+   *
+   * Chunks are static and do not depend on timing, so work that is
+   * independent per element produces exactly the same results as a serial
+   * loop.
+   */
+  void parallelFor(size_t size, size_t threads, size_t grain,
+      const boost::function<void (size_t, size_t)>& f);
+
+  /**
+   * Tells if the calling thread runs a chunk of parallelFor() split over
+   * several threads. Libraries with threads of their own, such as BLAS,
+   * should not be called from there, so as not to run more threads than
+   * processors.
+   */
+  bool inParallelFor();
+
+}}}
+
+#endif /* BOB_LEARN_LIBSVM_PARALLEL_H */
@@ -44,6 +44,10 @@ an original SVM text file as produced by ``libsvm``. The\n\
 second option is to pass a pre-opened HDF5 file pointing to the\n\
 machine information to be loaded in memory.\n\
 \n\
+Paths to files written by :py:meth:`save_binary` are recognized\n\
+as well: these are mapped into memory, without parsing, and\n\
+restore the scaling factors, like HDF5 files do.\n\
+\n\
 Using the first constructor, we build a new machine from a\n\
 libsvm model file. When you load using the libsvm model loader,\n\
 note that the scaling parameters will be set to defaults\n\
@@ -56,12 +60,60 @@ HDF5 file containing not only the machine support vectors, but\n\
 also the scaling factors. Using this constructor assures a 100%\n\
 state recovery from previous sessions.\n\
 \n\
+Predictions release the GIL, so a machine may serve several\n\
+Python threads at once. While it does, setting any of its\n\
+properties raises a :py:class:`RuntimeError`.\n\
+\n\
 ");
 
 /***********************************************
  * Implementation of bob.learn.libsvm.Machine *
  ***********************************************/
 
+/**
+ * Releases the GIL while "self" predicts. Predictions running on other
+ * threads are counted, so the setters below can refuse to change the machine
+ * under them. The count is only changed while holding the GIL.
+ */
+class PyBobLearnLibsvmMachine_NoGIL {
+
+  public:
+
+    PyBobLearnLibsvmMachine_NoGIL(PyBobLearnLibsvmMachineObject* self):
+      m_self(self) {
+      ++m_self->predictions;
+      m_state = PyEval_SaveThread();
+    }
+
+    ~PyBobLearnLibsvmMachine_NoGIL() {
+      PyEval_RestoreThread(m_state);
+      --m_self->predictions;
+    }
+
+  private:
+
+    PyBobLearnLibsvmMachine_NoGIL(const PyBobLearnLibsvmMachine_NoGIL&);
+
+    PyBobLearnLibsvmMachine_NoGIL& operator=
+      (const PyBobLearnLibsvmMachine_NoGIL&);
+
+    PyBobLearnLibsvmMachineObject* m_self;
+    PyThreadState* m_state;
+
+};
+
+/**
+ * Checks no prediction by "self" is running on another thread before
+ * "attribute" is changed, as changing the machine may release memory the
+ * prediction is reading. Returns 0 and sets a RuntimeError otherwise.
+ */
+static int PyBobLearnLibsvmMachine_CheckIdle
+(PyBobLearnLibsvmMachineObject* self, const char* attribute) {
+  if (!self->predictions) return 1;
+  PyErr_Format(PyExc_RuntimeError, "cannot reset `%s' of %s while it predicts on other threads", attribute, Py_TYPE(self)->tp_name);
+  return 0;
+}
+
 static int PyBobLearnLibsvmMachine_init_svmfile
 (PyBobLearnLibsvmMachineObject* self, PyObject* args, PyObject* kwds) {
 
@@ -176,6 +228,8 @@ static PyObject* PyBobLearnLibsvmMachine_getInputSubtraction
 static int PyBobLearnLibsvmMachine_setInputSubtraction
 (PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
 
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "input_subtract")) return -1;
+
   PyBlitzArrayObject* input_subtract = 0;
   if (!PyBlitzArray_Converter(o, &input_subtract)) return -1;
   auto input_subtract_ = make_safe(input_subtract);
@@ -216,6 +270,8 @@ static PyObject* PyBobLearnLibsvmMachine_getInputDivision
 static int PyBobLearnLibsvmMachine_setInputDivision
 (PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
 
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "input_divide")) return -1;
+
   PyBlitzArrayObject* input_divide = 0;
   if (!PyBlitzArray_Converter(o, &input_divide)) return -1;
   auto input_divide_ = make_safe(input_divide);
@@ -339,6 +395,318 @@ static PyObject* PyBobLearnLibsvmMachine_getSupportsProbability
   Py_RETURN_FALSE;
 }
 
+PyDoc_STRVAR(s_n_threads_str, "n_threads");
+PyDoc_STRVAR(s_n_threads_doc,
+"The number of threads used to score 2D inputs. Rows are split\n\
+in contiguous blocks, one per thread, so results do not depend\n\
+on this setting. Setting it to ``0`` selects the number of\n\
+hardware threads available. The default is read from\n\
+the environment variable ``BOB_LEARN_LIBSVM_THREADS`` when the\n\
+machine is created (``1``, if that is not set).\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_getNumberOfThreads
+(PyBobLearnLibsvmMachineObject* self, void* /*closure*/) {
+  return Py_BuildValue("n", self->cxx->getNumberOfThreads());
+}
+
+static int PyBobLearnLibsvmMachine_setNumberOfThreads
+(PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
+
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "n_threads")) return -1;
+
+  Py_ssize_t threads = PyNumber_AsSsize_t(o, PyExc_OverflowError);
+  if (PyErr_Occurred()) return -1;
+
+  if (threads < 0) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires a non-negative number of threads, not %" PY_FORMAT_SIZE_T "d", Py_TYPE(self)->tp_name, threads);
+    return -1;
+  }
+
+  self->cxx->setNumberOfThreads(threads);
+  return 0;
+
+}
+
+PyDoc_STRVAR(s_early_voting_str, "early_voting");
+PyDoc_STRVAR(s_early_voting_doc,
+"Set to ``True`` to stop the one-vs-one voting of\n\
+:py:meth:`predict_class` (and of calling the machine) as soon as\n\
+no class can catch up with the leader. Only applies to\n\
+``C_SVC`` and ``NU_SVC`` machines with more than 2 classes that\n\
+are :py:attr:`dense` or :py:attr:`collapsed`: decision functions\n\
+are then evaluated on demand, starting with the ones of the most\n\
+likely winner. Labels are identical to those of a full vote.\n\
+``True`` by default.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_getEarlyVoting
+(PyBobLearnLibsvmMachineObject* self, void* /*closure*/) {
+  if (self->cxx->isEarlyVoting()) Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
+static int PyBobLearnLibsvmMachine_setEarlyVoting
+(PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
+
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "early_voting")) return -1;
+
+  int early = PyObject_IsTrue(o);
+  if (early < 0) return -1;
+
+  self->cxx->setEarlyVoting(early);
+  return 0;
+
+}
+
+PyDoc_STRVAR(s_dense_str, "dense");
+PyDoc_STRVAR(s_dense_doc,
+"Set to ``True`` if predictions use a dense copy of the support\n\
+vectors, evaluated by this package, instead of LIBSVM's sparse\n\
+evaluator. The dense evaluator uses SIMD instructions (AVX2 or\n\
+AVX-512) when the CPU supports them, so scores may differ from\n\
+LIBSVM's by rounding: by about the number of features times\n\
+2^-53, relative to the magnitude of the features and support\n\
+vectors, which is typically less than 1e-12. RBF distances that\n\
+would lose precision to cancellation, between inputs close to a\n\
+support vector with large norms, are summed as LIBSVM does. The\n\
+dense copy is used by default, unless the model is so sparse that\n\
+it would take more memory than the original support vectors, it\n\
+is :py:attr:`collapsed`, or it has support vector indices below 1,\n\
+which have no dense column. You may set this property to change\n\
+that choice, but for the latter models.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_getDense
+(PyBobLearnLibsvmMachineObject* self, void* /*closure*/) {
+  if (self->cxx->isDense()) Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
+static int PyBobLearnLibsvmMachine_setDense
+(PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
+
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "dense")) return -1;
+
+  int dense = PyObject_IsTrue(o);
+  if (dense < 0) return -1;
+
+  try {
+    self->cxx->setDense(dense);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `dense' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(s_collapsed_str, "collapsed");
+PyDoc_STRVAR(s_collapsed_doc,
+"Set to ``True`` if predictions use one weight vector per\n\
+decision function (see :py:attr:`weights`), instead of evaluating\n\
+the kernel on every support vector. This is only possible with\n\
+``LINEAR`` kernels, for which it is the default: predictions then\n\
+cost one dot product per decision function, whatever the number\n\
+of support vectors. Scores differ from LIBSVM's by rounding only.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_getCollapsed
+(PyBobLearnLibsvmMachineObject* self, void* /*closure*/) {
+  if (self->cxx->isCollapsed()) Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
+static int PyBobLearnLibsvmMachine_setCollapsed
+(PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
+
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "collapsed")) return -1;
+
+  int collapsed = PyObject_IsTrue(o);
+  if (collapsed < 0) return -1;
+
+  try {
+    self->cxx->setCollapsed(collapsed);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `collapsed' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(s_single_precision_str, "single_precision");
+PyDoc_STRVAR(s_single_precision_doc,
+"Set to ``True`` to run predictions in single precision. Support\n\
+vectors (or weight vectors, if :py:attr:`collapsed`), inputs and\n\
+kernel values are then stored as 32-bit floats, which halves\n\
+memory traffic and doubles the throughput of SIMD instructions.\n\
+Scores and probabilities are only accurate to about 1e-5 relative\n\
+to their magnitude: on the bundled heart and iris models, labels\n\
+do not change and scores stay within 1e-4 of double precision\n\
+ones. Only available for :py:attr:`dense` or :py:attr:`collapsed`\n\
+machines. ``False`` by default.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_getSinglePrecision
+(PyBobLearnLibsvmMachineObject* self, void* /*closure*/) {
+  if (self->cxx->isSinglePrecision()) Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
+static int PyBobLearnLibsvmMachine_setSinglePrecision
+(PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
+
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "single_precision")) return -1;
+
+  int single = PyObject_IsTrue(o);
+  if (single < 0) return -1;
+
+  try {
+    self->cxx->setSinglePrecision(single);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `single_precision' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(s_quantization_str, "quantization");
+PyDoc_STRVAR(s_quantization_doc,
+"The number of bits of the integer codes the :py:attr:`dense`\n\
+support vectors are stored as: ``8``, ``16``, or ``0`` (the\n\
+default) if they are stored as 64-bit floats. Values of every\n\
+dimension are mapped linearly from their range over all support\n\
+vectors to the codes, so 8-bit codes take 8 times less memory.\n\
+Scores then differ from LIBSVM's by an amount that depends on the\n\
+model: use :py:meth:`quantization_error` to measure it on\n\
+representative data. Only available for :py:attr:`dense`\n\
+machines.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_getQuantization
+(PyBobLearnLibsvmMachineObject* self, void* /*closure*/) {
+  return Py_BuildValue("n", self->cxx->quantization());
+}
+
+static int PyBobLearnLibsvmMachine_setQuantization
+(PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
+
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "quantization")) return -1;
+
+  Py_ssize_t bits = PyNumber_AsSsize_t(o, PyExc_OverflowError);
+  if (PyErr_Occurred()) return -1;
+
+  if (bits < 0) {
+    PyErr_Format(PyExc_ValueError, "`%s' requires a non-negative number of bits, not %" PY_FORMAT_SIZE_T "d", Py_TYPE(self)->tp_name, bits);
+    return -1;
+  }
+
+  try {
+    self->cxx->setQuantization(bits);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `quantization' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(s_compact_str, "compact");
+PyDoc_STRVAR(s_compact_doc,
+"``True`` if the :py:attr:`dense` support vectors are the only copy\n\
+of the support vectors kept in memory. LIBSVM's own copy stores an\n\
+index next to every non-zero value, so is released: it is rebuilt\n\
+when the machine is saved, or for good if the representation\n\
+changes. This is the default for dense machines loaded from files.\n\
+Setting it requires a :py:attr:`dense` machine, not\n\
+:py:attr:`collapsed`. Setting :py:attr:`quantization` turns it off,\n\
+as setting it back on discards the exact support vectors.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_getCompact
+(PyBobLearnLibsvmMachineObject* self, void* /*closure*/) {
+  if (self->cxx->isCompact()) Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
+static int PyBobLearnLibsvmMachine_setCompact
+(PyBobLearnLibsvmMachineObject* self, PyObject* o, void* /*closure*/) {
+
+  if (!PyBobLearnLibsvmMachine_CheckIdle(self, "compact")) return -1;
+
+  int compact = PyObject_IsTrue(o);
+  if (compact < 0) return -1;
+
+  try {
+    self->cxx->setCompact(compact);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return -1;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot reset `compact' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+    return -1;
+  }
+
+  return 0;
+
+}
+
+PyDoc_STRVAR(s_weights_str, "weights");
+PyDoc_STRVAR(s_weights_doc,
+"The weight vectors of a ``LINEAR`` machine, as a 2D array with\n\
+one row per decision function, in the order scores are returned.\n\
+Each score is the dot product between the scaled input (see\n\
+:py:attr:`input_subtract` and :py:attr:`input_divide`) and a row,\n\
+minus the machine's matching bias. ``None`` for other kernels.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_getWeights
+(PyBobLearnLibsvmMachineObject* self, void* /*closure*/) {
+
+  if (self->cxx->kernelType() != bob::learn::libsvm::LINEAR) Py_RETURN_NONE;
+
+  try {
+    return PyBlitzArray_NUMPY_WRAP(PyBlitzArrayCxx_NewFromArray(self->cxx->getWeights()));
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "cannot read `weights' of %s: unknown exception caught", Py_TYPE(self)->tp_name);
+  }
+
+  return 0;
+
+}
+
 static PyGetSetDef PyBobLearnLibsvmMachine_getseters[] = {
     {
       s_input_subtract_str,
@@ -419,6 +787,62 @@ static PyGetSetDef PyBobLearnLibsvmMachine_getseters[] = {
       s_probability_doc,
       0
     },
+    {
+      s_dense_str,
+      (getter)PyBobLearnLibsvmMachine_getDense,
+      (setter)PyBobLearnLibsvmMachine_setDense,
+      s_dense_doc,
+      0
+    },
+    {
+      s_collapsed_str,
+      (getter)PyBobLearnLibsvmMachine_getCollapsed,
+      (setter)PyBobLearnLibsvmMachine_setCollapsed,
+      s_collapsed_doc,
+      0
+    },
+    {
+      s_single_precision_str,
+      (getter)PyBobLearnLibsvmMachine_getSinglePrecision,
+      (setter)PyBobLearnLibsvmMachine_setSinglePrecision,
+      s_single_precision_doc,
+      0
+    },
+    {
+      s_quantization_str,
+      (getter)PyBobLearnLibsvmMachine_getQuantization,
+      (setter)PyBobLearnLibsvmMachine_setQuantization,
+      s_quantization_doc,
+      0
+    },
+    {
+      s_compact_str,
+      (getter)PyBobLearnLibsvmMachine_getCompact,
+      (setter)PyBobLearnLibsvmMachine_setCompact,
+      s_compact_doc,
+      0
+    },
+    {
+      s_weights_str,
+      (getter)PyBobLearnLibsvmMachine_getWeights,
+      0,
+      s_weights_doc,
+      0
+    },
+    {
+      s_n_threads_str,
+      (getter)PyBobLearnLibsvmMachine_getNumberOfThreads,
+      (setter)PyBobLearnLibsvmMachine_setNumberOfThreads,
+      s_n_threads_doc,
+      0
+    },
+    {
+      s_early_voting_str,
+      (getter)PyBobLearnLibsvmMachine_getEarlyVoting,
+      (setter)PyBobLearnLibsvmMachine_setEarlyVoting,
+      s_early_voting_doc,
+      0
+    },
     {0}  /* Sentinel */
 };
 
@@ -468,6 +892,364 @@ PyObject* PyBobLearnLibsvmMachine_Str(PyBobLearnLibsvmMachineObject* self) {
 
 }
 
+/**
+ * Keyword arguments of the prediction methods, by number of outputs: labels
+ * only, labels and scores or labels and probabilities
+ */
+static const char* s_predict_kwlist[3][4] = {
+  {"input", "output", 0, 0},
+  {"input", "cls", "score", 0},
+  {"input", "cls", "prob", 0},
+};
+
+/**
+ * Sets "view" to refer to the data of numpy array "o", without copying or
+ * allocating memory, if "o" is an aligned array of N dimensions of type T in
+ * native byte order, with non-negative strides. Output arrays must also be
+ * C-contiguous and writeable. Returns false, without setting an exception,
+ * otherwise.
+ */
+template <typename T, int N>
+static bool PyBobLearnLibsvm_View(PyObject* o, bool output,
+    blitz::Array<T,N>& view) {
+
+  if (!o || !PyArray_Check(o)) return false;
+  PyArrayObject* array = reinterpret_cast<PyArrayObject*>(o);
+
+  if (PyArray_NDIM(array) != N ||
+      PyArray_TYPE(array) != PyBlitzArrayCxx_CToTypenum<T>() ||
+      !PyArray_ISALIGNED(array) || !PyArray_ISNOTSWAPPED(array)) return false;
+
+  if (output && (!PyArray_ISWRITEABLE(array) ||
+        !PyArray_IS_C_CONTIGUOUS(array))) return false;
+
+  blitz::TinyVector<int,N> shape;
+  blitz::TinyVector<ptrdiff_t,N> stride;
+  for (int k=0; k<N; ++k) {
+    npy_intp bytes = PyArray_STRIDE(array, k);
+    if (bytes < 0 || bytes % sizeof(T)) return false;
+    shape(k) = PyArray_DIM(array, k);
+    stride(k) = bytes / sizeof(T);
+  }
+
+  view.reference(blitz::Array<T,N>(static_cast<T*>(PyArray_DATA(array)),
+        shape, stride, blitz::neverDeleteData));
+  return true;
+
+}
+
+/**
+ * Calls the unchecked prediction methods of "self" on a single input
+ */
+template <typename I>
+static void PyBobLearnLibsvm_Predict(PyBobLearnLibsvmMachineObject* self,
+    const blitz::Array<I,1>& input, blitz::Array<int64_t,1>& cls,
+    blitz::Array<double,1>& values, int outputs) {
+  const bob::learn::libsvm::Machine& m = *self->cxx;
+  if (outputs == 1) cls(0) = m.predictClassAndScores_(input, values);
+  else if (outputs == 2) cls(0) = m.predictClassAndProbabilities_(input, values);
+  else cls(0) = m.predictClass_(input);
+}
+
+/**
+ * Calls the unchecked batch prediction methods of "self", without holding the
+ * GIL
+ */
+template <typename I>
+static void PyBobLearnLibsvm_Predict(PyBobLearnLibsvmMachineObject* self,
+    const blitz::Array<I,2>& input, blitz::Array<int64_t,1>& cls,
+    blitz::Array<double,2>& values, int outputs) {
+  const bob::learn::libsvm::Machine& m = *self->cxx;
+  PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by the caller
+  if (outputs == 1) m.predictClassAndScoresBatch_(input, cls, values);
+  else if (outputs == 2) m.predictClassAndProbabilitiesBatch_(input, cls, values);
+  else m.predictClassBatch_(input, cls);
+}
+
+/**
+ * Predicts N-dimensional "input" of type I into "cls" and "values", if all
+ * can be viewed in place. See PyBobLearnLibsvmMachine_predictInPlace().
+ */
+template <typename I, int N>
+static PyObject* PyBobLearnLibsvmMachine_predictViews
+(PyBobLearnLibsvmMachineObject* self, PyObject* input, PyObject* cls,
+ PyObject* values, int outputs) {
+
+  blitz::Array<I,N> bzin;
+  if (!PyBobLearnLibsvm_View(input, false, bzin)) return 0;
+  if ((size_t)bzin.extent(N-1) != self->cxx->inputSize()) return 0;
+
+  npy_intp N_ = self->cxx->outputSize();
+  npy_intp rows = (N == 1)? 1 : bzin.extent(0);
+  npy_intp columns = (outputs == 1)? (N_ < 2 ? 1 : (N_*(N_-1))/2) :
+    self->cxx->numberOfClasses();
+
+  blitz::Array<int64_t,1> bzcls;
+  if (cls && (!PyBobLearnLibsvm_View(cls, true, bzcls) ||
+        bzcls.extent(0) != rows)) return 0;
+
+  blitz::Array<double,N> bzvalues;
+  if (values && (!PyBobLearnLibsvm_View(values, true, bzvalues) ||
+        bzvalues.extent(0) != (N == 1 ? columns : rows) ||
+        bzvalues.extent(N-1) != columns)) return 0;
+
+  /** outputs that were not pre-allocated are the only memory allocated **/
+  if (!cls) {
+    cls = PyArray_SimpleNew(1, &rows, NPY_INT64);
+    if (!cls) return 0;
+    bob::learn::libsvm::Machine::countAllocations();
+    PyBobLearnLibsvm_View(cls, true, bzcls);
+  }
+  else Py_INCREF(cls);
+  auto cls_ = make_safe(cls);
+
+  if (outputs && !values) {
+    npy_intp shape[2] = {(N == 1)? columns : rows, columns};
+    values = PyArray_SimpleNew(N, shape, NPY_FLOAT64);
+    if (!values) return 0;
+    bob::learn::libsvm::Machine::countAllocations();
+    PyBobLearnLibsvm_View(values, true, bzvalues);
+  }
+  else Py_XINCREF(values);
+  auto values_ = make_xsafe(values);
+
+  try {
+    PyBobLearnLibsvm_Predict(self, bzin, bzcls, bzvalues, outputs);
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot forward data: unknown exception caught", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  if (!outputs) {
+    Py_INCREF(cls);
+    return cls;
+  }
+  return Py_BuildValue("OO", cls, values);
+
+}
+
+/**
+ * Serves the prediction methods for numpy arrays of 32 or 64-bit floats that
+ * can be read, and outputs that can be written, in place: the only objects
+ * created are the outputs that were not pre-allocated. "outputs" is as for
+ * PyBobLearnLibsvmMachine_predictSparse(). Returns 0 without an exception set
+ * for any other arguments, which are then served, or rejected, by the
+ * general path.
+ */
+static PyObject* PyBobLearnLibsvmMachine_predictInPlace
+(PyBobLearnLibsvmMachineObject* self, PyObject* args, PyObject* kwds,
+ int outputs) {
+
+  char** kwlist = const_cast<char**>(s_predict_kwlist[outputs]);
+
+  PyObject* input = 0;
+  PyObject* cls = 0;
+  PyObject* values = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, outputs? "O|OO" : "O|O",
+        kwlist, &input, &cls, &values)) return 0;
+
+  if (!PyArray_Check(input)) return 0;
+
+  PyArrayObject* array = reinterpret_cast<PyArrayObject*>(input);
+  const bool single = PyArray_TYPE(array) == NPY_FLOAT32;
+  switch (PyArray_NDIM(array)) {
+    case 1:
+      return single?
+        PyBobLearnLibsvmMachine_predictViews<float,1>(self, input, cls, values, outputs) :
+        PyBobLearnLibsvmMachine_predictViews<double,1>(self, input, cls, values, outputs);
+    case 2:
+      return single?
+        PyBobLearnLibsvmMachine_predictViews<float,2>(self, input, cls, values, outputs) :
+        PyBobLearnLibsvmMachine_predictViews<double,2>(self, input, cls, values, outputs);
+    default:
+      return 0;
+  }
+
+}
+
+/**
+ * Tells if the ``input`` argument of a prediction method, in "args" or
+ * "kwds", is a sparse matrix: any object with the ``indptr``, ``indices``
+ * and ``data`` attributes of a scipy.sparse.csr_matrix
+ */
+static bool PyBobLearnLibsvm_IsSparse(PyObject* args, PyObject* kwds) {
+  PyObject* input = 0;
+  if (args && PyTuple_Size(args) > 0) input = PyTuple_GET_ITEM(args, 0);
+  else if (kwds) input = PyDict_GetItemString(kwds, "input");
+  return input && PyObject_HasAttrString(input, "indptr") &&
+    PyObject_HasAttrString(input, "indices") &&
+    PyObject_HasAttrString(input, "data");
+}
+
+/**
+ * Returns attribute "name" of sparse matrix "o", as a C-contiguous 1D array
+ * of the given numpy "dtype", converted if necessary
+ */
+static PyBlitzArrayObject* PyBobLearnLibsvm_SparseArray(PyObject* o,
+    const char* name, const char* dtype) {
+
+  PyObject* attr = PyObject_GetAttrString(o, name);
+  if (!attr) return 0;
+  auto attr_ = make_safe(attr);
+
+  PyObject* numpy = PyImport_ImportModule("numpy");
+  if (!numpy) return 0;
+  auto numpy_ = make_safe(numpy);
+
+  PyObject* array = PyObject_CallMethod(numpy,
+      const_cast<char*>("ascontiguousarray"), const_cast<char*>("Os"), attr,
+      dtype);
+  if (!array) return 0;
+  auto array_ = make_safe(array);
+
+  PyBlitzArrayObject* retval = 0;
+  if (!PyBlitzArray_Converter(array, &retval)) return 0;
+
+  if (retval->ndim != 1) {
+    PyErr_Format(PyExc_TypeError, "the `%s' array of sparse inputs should be 1D, not %" PY_FORMAT_SIZE_T "dD", name, retval->ndim);
+    Py_DECREF(retval);
+    return 0;
+  }
+
+  return retval;
+
+}
+
+/**
+ * Implements the prediction methods for sparse inputs in CSR format:
+ * "outputs" is 0 for labels only, 1 for labels and scores, 2 for labels and
+ * probabilities. Arguments are the same as for dense inputs.
+ */
+static PyObject* PyBobLearnLibsvmMachine_predictSparse
+(PyBobLearnLibsvmMachineObject* self, PyObject* args, PyObject* kwds,
+ int outputs) {
+
+  char** kwlist = const_cast<char**>(s_predict_kwlist[outputs]);
+
+  PyObject* input = 0;
+  PyBlitzArrayObject* cls = 0;
+  PyBlitzArrayObject* values = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, outputs? "O|O&O&" : "O|O&",
+        kwlist, &input,
+        &PyBlitzArray_OutputConverter, &cls,
+        &PyBlitzArray_OutputConverter, &values
+        )) return 0;
+
+  //protects acquired resources through this scope
+  auto cls_ = make_xsafe(cls);
+  auto values_ = make_xsafe(values);
+
+  if (PyObject_HasAttrString(input, "format")) {
+    PyObject* format = PyObject_GetAttrString(input, "format");
+    if (!format) return 0;
+    auto format_ = make_safe(format);
+    PyObject* csr = Py_BuildValue("s", "csr");
+    auto csr_ = make_safe(csr);
+    int is_csr = PyObject_RichCompareBool(format, csr, Py_EQ);
+    if (is_csr < 0) return 0;
+    if (!is_csr) {
+      PyErr_Format(PyExc_TypeError, "`%s' only accepts sparse inputs in CSR format - convert them with `tocsr()'", Py_TYPE(self)->tp_name);
+      return 0;
+    }
+  }
+
+  PyBlitzArrayObject* indptr = PyBobLearnLibsvm_SparseArray(input, "indptr",
+      "int64");
+  if (!indptr) return 0;
+  auto indptr_ = make_safe(indptr);
+  PyBlitzArrayObject* indices = PyBobLearnLibsvm_SparseArray(input, "indices",
+      "int64");
+  if (!indices) return 0;
+  auto indices_ = make_safe(indices);
+  PyBlitzArrayObject* data = PyBobLearnLibsvm_SparseArray(input, "data",
+      "float64");
+  if (!data) return 0;
+  auto data_ = make_safe(data);
+
+  if (indptr->shape[0] < 1) {
+    PyErr_Format(PyExc_RuntimeError, "the `indptr' array of sparse inputs should have at least 1 element");
+    return 0;
+  }
+  Py_ssize_t rows = indptr->shape[0] - 1;
+
+  if (cls && (cls->type_num != NPY_INT64 || cls->ndim != 1 ||
+        cls->shape[0] != rows)) {
+    PyErr_Format(PyExc_RuntimeError, "the `%s' array should be a 1D array of 64-bit integers with %" PY_FORMAT_SIZE_T "d elements, matching the number of rows of `input'", kwlist[1], rows);
+    return 0;
+  }
+
+  Py_ssize_t N = self->cxx->outputSize();
+  Py_ssize_t columns = (outputs == 1)? (N < 2 ? 1 : (N*(N-1))/2) :
+    self->cxx->numberOfClasses();
+  if (values && (values->type_num != NPY_FLOAT64 || values->ndim != 2 ||
+        values->shape[0] != rows || values->shape[1] != columns)) {
+    PyErr_Format(PyExc_RuntimeError, "the `%s' array should be a 2D array of 64-bit floats with shape (%" PY_FORMAT_SIZE_T "d, %" PY_FORMAT_SIZE_T "d)", kwlist[2], rows, columns);
+    return 0;
+  }
+
+  /** if outputs were not pre-allocated, do it now **/
+  if (!cls) {
+    cls = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT64, 1, &rows);
+    if (!cls) return 0;
+    cls_ = make_safe(cls);
+    bob::learn::libsvm::Machine::countAllocations();
+  }
+
+  if (outputs && !values) {
+    Py_ssize_t osize[2] = {rows, columns};
+    values = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 2, osize);
+    if (!values) return 0;
+    values_ = make_safe(values);
+    bob::learn::libsvm::Machine::countAllocations();
+  }
+
+  /** the machine checks the sparse matrix itself **/
+  try {
+    auto bzptr = PyBlitzArrayCxx_AsBlitz<int64_t,1>(indptr);
+    auto bzindices = PyBlitzArrayCxx_AsBlitz<int64_t,1>(indices);
+    auto bzdata = PyBlitzArrayCxx_AsBlitz<double,1>(data);
+    auto bzcls = PyBlitzArrayCxx_AsBlitz<int64_t,1>(cls);
+    PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by this scope
+    if (outputs == 1) {
+      self->cxx->predictClassAndScoresBatch(*bzptr, *bzindices, *bzdata,
+          *bzcls, *PyBlitzArrayCxx_AsBlitz<double,2>(values));
+    }
+    else if (outputs == 2) {
+      self->cxx->predictClassAndProbabilitiesBatch(*bzptr, *bzindices,
+          *bzdata, *bzcls, *PyBlitzArrayCxx_AsBlitz<double,2>(values));
+    }
+    else {
+      self->cxx->predictClassBatch(*bzptr, *bzindices, *bzdata, *bzcls);
+    }
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot forward data: unknown exception caught", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  Py_INCREF(cls);
+  if (!outputs) {
+    return PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(cls));
+  }
+  Py_INCREF(values);
+  return Py_BuildValue("NN",
+      PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(cls)),
+      PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(values))
+      );
+
+}
+
 PyDoc_STRVAR(s_forward_str, "forward");
 PyDoc_STRVAR(s_forward_doc,
 "o.forward(input, [output]) -> array\n\
@@ -479,20 +1261,45 @@ o(input, [output]) -> array\n\
 Calculates the **predicted class** using this Machine, given\n\
 one single feature vector or multiple ones.\n\
 \n\
-The ``input`` array can be either 1D or 2D 64-bit float arrays.\n\
+The ``input`` array can be either 1D or 2D 32 or 64-bit float\n\
+arrays, not necessarily contiguous: 32-bit values and strided rows\n\
+are converted as they are read, without copying ``input`` first.\n\
 The ``output`` array, if provided, must be of type ``int64``,\n\
 always uni-dimensional. The output corresponds to the predicted\n\
 classes for each of the input rows.\n\
 \n\
 .. note::\n\
 \n\
-   This method only accepts 64-bit float arrays as input and\n\
+   This method only accepts 32 or 64-bit float arrays as input and\n\
    64-bit integers as output.\n\
+\n\
+2D inputs are processed without holding Python's global\n\
+interpreter lock, so that several threads may score data\n\
+concurrently.\n\
+\n\
+Aligned numpy arrays in native byte order are read, and\n\
+C-contiguous outputs written, in place. Once this machine has\n\
+served a few calls, predictions into pre-allocated outputs do not\n\
+allocate memory (see :py:meth:`allocations`).\n\
+\n\
+``input`` may also be a sparse matrix in CSR format, such as a\n\
+:py:class:`scipy.sparse.csr_matrix`, with one row per feature\n\
+vector. Its rows are read without being densified: columns beyond\n\
+the input size of this Machine are ignored and column indices of\n\
+each row must be sorted (see ``sort_indices()``).\n\
 \n");
 
 static PyObject* PyBobLearnLibsvmMachine_forward
 (PyBobLearnLibsvmMachineObject* self, PyObject* args, PyObject* kwds) {
 
+  if (PyBobLearnLibsvm_IsSparse(args, kwds)) {
+    return PyBobLearnLibsvmMachine_predictSparse(self, args, kwds, 0);
+  }
+
+  PyObject* retval = PyBobLearnLibsvmMachine_predictInPlace(self, args, kwds,
+      0);
+  if (retval || PyErr_Occurred()) return retval;
+
   static const char* const_kwlist[] = {"input", "output", 0};
   static char** kwlist = const_cast<char**>(const_kwlist);
 
@@ -500,7 +1307,7 @@ static PyObject* PyBobLearnLibsvmMachine_forward
   PyBlitzArrayObject* output = 0;
 
   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|O&", kwlist,
-        &PyBlitzArray_Converter, &input,
+        &PyBlitzArray_BehavedConverter, &input,
         &PyBlitzArray_OutputConverter, &output
         )) return 0;
 
@@ -508,8 +1315,8 @@ static PyObject* PyBobLearnLibsvmMachine_forward
   auto input_ = make_safe(input);
   auto output_ = make_xsafe(output);
 
-  if (input->type_num != NPY_FLOAT64) {
-    PyErr_Format(PyExc_TypeError, "`%s' only supports 64-bit float arrays for input array `input'", Py_TYPE(self)->tp_name);
+  if (input->type_num != NPY_FLOAT64 && input->type_num != NPY_FLOAT32) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 32 or 64-bit float arrays for input array `input'", Py_TYPE(self)->tp_name);
     return 0;
   }
 
@@ -555,22 +1362,27 @@ static PyObject* PyBobLearnLibsvmMachine_forward
     if (input->ndim == 2) osize = input->shape[0];
     output = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT64, 1, &osize);
     output_ = make_safe(output);
+    bob::learn::libsvm::Machine::countAllocations();
   }
 
   /** all basic checks are done, can call the machine now **/
   try {
-    if (input->ndim == 1) {
-      auto bzout = PyBlitzArrayCxx_AsBlitz<int64_t,1>(output);
+    auto bzout = PyBlitzArrayCxx_AsBlitz<int64_t,1>(output);
+    if (input->ndim == 1 && input->type_num == NPY_FLOAT32) {
+      (*bzout)(0) = self->cxx->predictClass_(*PyBlitzArrayCxx_AsBlitz<float,1>(input));
+    }
+    else if (input->ndim == 1) {
       (*bzout)(0) = self->cxx->predictClass_(*PyBlitzArrayCxx_AsBlitz<double,1>(input));
     }
+    else if (input->type_num == NPY_FLOAT32) {
+      auto bzin = PyBlitzArrayCxx_AsBlitz<float,2>(input);
+      PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by this scope
+      self->cxx->predictClassBatch_(*bzin, *bzout); ///< no need to re-check
+    }
     else {
       auto bzin = PyBlitzArrayCxx_AsBlitz<double,2>(input);
-      auto bzout = PyBlitzArrayCxx_AsBlitz<int64_t,1>(output);
-      blitz::Range all = blitz::Range::all();
-      for (int k=0; k<bzin->extent(0); ++k) {
-        blitz::Array<double,1> i_ = (*bzin)(k, all);
-        (*bzout)(k) = self->cxx->predictClass_(i_); ///< no need to re-check
-      }
+      PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by this scope
+      self->cxx->predictClassBatch_(*bzin, *bzout); ///< no need to re-check
     }
   }
   catch (std::exception& e) {
@@ -595,11 +1407,12 @@ Calculates the **predicted class** and output scores for the SVM\n\
 using the this Machine, given one single feature vector or multiple\n\
 ones.\n\
 \n\
-The ``input`` array can be either 1D or 2D 64-bit float arrays.\n\
+The ``input`` array can be either 1D or 2D 32 or 64-bit float\n\
+arrays, not necessarily contiguous (see :py:meth:`forward`).\n\
 The ``cls`` array, if provided, must be of type ``int64``,\n\
 always uni-dimensional. The ``cls`` output corresponds to the\n\
 predicted classes for each of the input rows. The ``score`` array,\n\
-if provided, must be of type ``float64`` (like ``input``) and have\n\
+if provided, must be of type ``float64`` and have\n\
 as many rows as ``input`` and ``C`` columns, matching the \n\
 number of combinations of the outputs 2-by-2. To score, LIBSVM\n\
 will compare the SV outputs for each set two classes in the machine\n\
@@ -617,11 +1430,26 @@ If you don't provide the arrays upon calling this method, we will\n\
 allocate new ones internally and return them. If you are calling\n\
 this method on a tight loop, it is recommended you pass the ``cls``\n\
 and ``score`` arrays to avoid constant re-allocation.\n\
+\n\
+2D inputs are processed without holding Python's global\n\
+interpreter lock, so that several threads may score data\n\
+concurrently. Their kernels are evaluated in blocks of rows,\n\
+by matrix products, giving the same scores as the rows passed\n\
+one by one. Sparse matrices in CSR format are also accepted as\n\
+``input`` (see :py:meth:`forward`).\n\
 ");
 
 static PyObject* PyBobLearnLibsvmMachine_predictClassAndScores
 (PyBobLearnLibsvmMachineObject* self, PyObject* args, PyObject* kwds) {
 
+  if (PyBobLearnLibsvm_IsSparse(args, kwds)) {
+    return PyBobLearnLibsvmMachine_predictSparse(self, args, kwds, 1);
+  }
+
+  PyObject* retval = PyBobLearnLibsvmMachine_predictInPlace(self, args, kwds,
+      1);
+  if (retval || PyErr_Occurred()) return retval;
+
   static const char* const_kwlist[] = {"input", "cls", "score", 0};
   static char** kwlist = const_cast<char**>(const_kwlist);
 
@@ -630,7 +1458,7 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndScores
   PyBlitzArrayObject* score = 0;
 
   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|O&O&", kwlist,
-        &PyBlitzArray_Converter, &input,
+        &PyBlitzArray_BehavedConverter, &input,
         &PyBlitzArray_OutputConverter, &cls,
         &PyBlitzArray_OutputConverter, &score
         )) return 0;
@@ -645,8 +1473,8 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndScores
   Py_ssize_t N = self->cxx->outputSize();
   Py_ssize_t number_of_scores = N < 2 ? 1 : (N*(N-1))/2;
 
-  if (input->type_num != NPY_FLOAT64) {
-    PyErr_Format(PyExc_TypeError, "`%s' only supports 64-bit float arrays for input array `input'", Py_TYPE(self)->tp_name);
+  if (input->type_num != NPY_FLOAT64 && input->type_num != NPY_FLOAT32) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 32 or 64-bit float arrays for input array `input'", Py_TYPE(self)->tp_name);
     return 0;
   }
 
@@ -714,6 +1542,7 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndScores
     if (input->ndim == 2) osize = input->shape[0];
     cls = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT64, 1, &osize);
     cls_ = make_safe(cls);
+    bob::learn::libsvm::Machine::countAllocations();
   }
 
   /** if ``score`` was not pre-allocated, do it now **/
@@ -728,26 +1557,32 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndScores
     }
     score = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, input->ndim, osize);
     score_ = make_safe(score);
+    bob::learn::libsvm::Machine::countAllocations();
   }
 
   /** all basic checks are done, can call the machine now **/
   try {
+    auto bzcls = PyBlitzArrayCxx_AsBlitz<int64_t,1>(cls);
     if (input->ndim == 1) {
-      auto bzin = PyBlitzArrayCxx_AsBlitz<double,1>(input);
-      auto bzcls = PyBlitzArrayCxx_AsBlitz<int64_t,1>(cls);
       auto bzscore = PyBlitzArrayCxx_AsBlitz<double,1>(score);
-      (*bzcls)(0) = self->cxx->predictClassAndScores_(*bzin, *bzscore);
+      if (input->type_num == NPY_FLOAT32) {
+        (*bzcls)(0) = self->cxx->predictClassAndScores_(*PyBlitzArrayCxx_AsBlitz<float,1>(input), *bzscore);
+      }
+      else {
+        (*bzcls)(0) = self->cxx->predictClassAndScores_(*PyBlitzArrayCxx_AsBlitz<double,1>(input), *bzscore);
+      }
+    }
+    else if (input->type_num == NPY_FLOAT32) {
+      auto bzin = PyBlitzArrayCxx_AsBlitz<float,2>(input);
+      auto bzscore = PyBlitzArrayCxx_AsBlitz<double,2>(score);
+      PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by this scope
+      self->cxx->predictClassAndScoresBatch_(*bzin, *bzcls, *bzscore);
     }
     else {
       auto bzin = PyBlitzArrayCxx_AsBlitz<double,2>(input);
-      auto bzcls = PyBlitzArrayCxx_AsBlitz<int64_t,1>(cls);
       auto bzscore = PyBlitzArrayCxx_AsBlitz<double,2>(score);
-      blitz::Range all = blitz::Range::all();
-      for (int k=0; k<bzin->extent(0); ++k) {
-        blitz::Array<double,1> i_ = (*bzin)(k, all);
-        blitz::Array<double,1> s_ = (*bzscore)(k, all);
-        (*bzcls)(k) = self->cxx->predictClassAndScores_(i_, s_);
-      }
+      PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by this scope
+      self->cxx->predictClassAndScoresBatch_(*bzin, *bzcls, *bzscore);
     }
   }
   catch (std::exception& e) {
@@ -776,11 +1611,12 @@ Calculates the **predicted class** and output probabilities for the\n\
 SVM using the this Machine, given one single feature vector or\n\
 multiple ones.\n\
 \n\
-The ``input`` array can be either 1D or 2D 64-bit float arrays.\n\
+The ``input`` array can be either 1D or 2D 32 or 64-bit float\n\
+arrays, not necessarily contiguous (see :py:meth:`forward`).\n\
 The ``cls`` array, if provided, must be of type ``int64``,\n\
 always uni-dimensional. The ``cls`` output corresponds to the\n\
 predicted classes for each of the input rows. The ``prob`` array,\n\
-if provided, must be of type ``float64`` (like ``input``) and have\n\
+if provided, must be of type ``float64`` and have\n\
 as many rows as ``input`` and ``len(o.labels)`` columns, matching\n\
 the number of classes for this SVM.\n\
 \n\
@@ -791,6 +1627,11 @@ array. If you don't provide the arrays upon calling this method, we\n\
 will allocate new ones internally and return them. If you are calling\n\
 this method on a tight loop, it is recommended you pass the ``cls``\n\
 and ``prob`` arrays to avoid constant re-allocation.\n\
+\n\
+2D inputs are processed without holding Python's global\n\
+interpreter lock, so that several threads may score data\n\
+concurrently. Sparse matrices in CSR format are also accepted\n\
+as ``input`` (see :py:meth:`forward`).\n\
 ");
 
 static PyObject* PyBobLearnLibsvmMachine_predictClassAndProbabilities
@@ -801,6 +1642,14 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndProbabilities
     return 0;
   }
 
+  if (PyBobLearnLibsvm_IsSparse(args, kwds)) {
+    return PyBobLearnLibsvmMachine_predictSparse(self, args, kwds, 2);
+  }
+
+  PyObject* retval = PyBobLearnLibsvmMachine_predictInPlace(self, args, kwds,
+      2);
+  if (retval || PyErr_Occurred()) return retval;
+
   static const char* const_kwlist[] = {"input", "cls", "prob", 0};
   static char** kwlist = const_cast<char**>(const_kwlist);
 
@@ -809,7 +1658,7 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndProbabilities
   PyBlitzArrayObject* prob= 0;
 
   if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|O&O&", kwlist,
-        &PyBlitzArray_Converter, &input,
+        &PyBlitzArray_BehavedConverter, &input,
         &PyBlitzArray_OutputConverter, &cls,
         &PyBlitzArray_OutputConverter, &prob
         )) return 0;
@@ -819,8 +1668,8 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndProbabilities
   auto cls_ = make_xsafe(cls);
   auto prob_ = make_xsafe(prob);
 
-  if (input->type_num != NPY_FLOAT64) {
-    PyErr_Format(PyExc_TypeError, "`%s' only supports 64-bit float arrays for input array `input'", Py_TYPE(self)->tp_name);
+  if (input->type_num != NPY_FLOAT64 && input->type_num != NPY_FLOAT32) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 32 or 64-bit float arrays for input array `input'", Py_TYPE(self)->tp_name);
     return 0;
   }
 
@@ -888,6 +1737,7 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndProbabilities
     if (input->ndim == 2) osize = input->shape[0];
     cls = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_INT64, 1, &osize);
     cls_ = make_safe(cls);
+    bob::learn::libsvm::Machine::countAllocations();
   }
 
   /** if ``prob`` was not pre-allocated, do it now **/
@@ -902,26 +1752,32 @@ static PyObject* PyBobLearnLibsvmMachine_predictClassAndProbabilities
     }
     prob = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, input->ndim, osize);
     prob_ = make_safe(prob);
+    bob::learn::libsvm::Machine::countAllocations();
   }
 
   /** all basic checks are done, can call the machine now **/
   try {
+    auto bzcls = PyBlitzArrayCxx_AsBlitz<int64_t,1>(cls);
     if (input->ndim == 1) {
-      auto bzin = PyBlitzArrayCxx_AsBlitz<double,1>(input);
-      auto bzcls = PyBlitzArrayCxx_AsBlitz<int64_t,1>(cls);
       auto bzprob = PyBlitzArrayCxx_AsBlitz<double,1>(prob);
-      (*bzcls)(0) = self->cxx->predictClassAndProbabilities_(*bzin, *bzprob);
+      if (input->type_num == NPY_FLOAT32) {
+        (*bzcls)(0) = self->cxx->predictClassAndProbabilities_(*PyBlitzArrayCxx_AsBlitz<float,1>(input), *bzprob);
+      }
+      else {
+        (*bzcls)(0) = self->cxx->predictClassAndProbabilities_(*PyBlitzArrayCxx_AsBlitz<double,1>(input), *bzprob);
+      }
+    }
+    else if (input->type_num == NPY_FLOAT32) {
+      auto bzin = PyBlitzArrayCxx_AsBlitz<float,2>(input);
+      auto bzprob = PyBlitzArrayCxx_AsBlitz<double,2>(prob);
+      PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by this scope
+      self->cxx->predictClassAndProbabilitiesBatch_(*bzin, *bzcls, *bzprob);
     }
     else {
       auto bzin = PyBlitzArrayCxx_AsBlitz<double,2>(input);
-      auto bzcls = PyBlitzArrayCxx_AsBlitz<int64_t,1>(cls);
       auto bzprob = PyBlitzArrayCxx_AsBlitz<double,2>(prob);
-      blitz::Range all = blitz::Range::all();
-      for (int k=0; k<bzin->extent(0); ++k) {
-        blitz::Array<double,1> i_ = (*bzin)(k, all);
-        blitz::Array<double,1> p_ = (*bzprob)(k, all);
-        (*bzcls)(k) = self->cxx->predictClassAndProbabilities_(i_, p_);
-      }
+      PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by this scope
+      self->cxx->predictClassAndProbabilitiesBatch_(*bzin, *bzcls, *bzprob);
     }
   }
   catch (std::exception& e) {
@@ -1000,6 +1856,123 @@ static PyObject* PyBobLearnLibsvmMachine_Save
 
 }
 
+PyDoc_STRVAR(s_save_binary_str, "save_binary");
+PyDoc_STRVAR(s_save_binary_doc,
+"o.save_binary(path) -> None\n\
+\n\
+Saves the machine, including its input normalization options,\n\
+in a binary format that the constructor of this class maps into\n\
+memory instead of parsing it. Support vectors are stored ready\n\
+to use, so that loading takes about the same time for models of\n\
+any size, and their memory is shared by all processes loading\n\
+the same file. Files can only be loaded on platforms with the\n\
+same byte order as the one they were saved on. Use this method\n\
+to convert existing LIBSVM or HDF5 models, after loading them.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_saveBinary
+(PyBobLearnLibsvmMachineObject* self, PyObject* f) {
+
+  const char* filename = 0;
+  if (!PyBobIo_FilenameConverter(f, &filename)) {
+    PyErr_Format(PyExc_TypeError, "cannot convert `%s' into a valid string for a file path", Py_TYPE(f)->tp_name);
+    return 0;
+  }
+
+  try {
+    self->cxx->saveBinary(filename);
+  }
+  catch (std::exception& ex) {
+    PyErr_SetString(PyExc_RuntimeError, ex.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "`%s' cannot write data to file `%s' (using the binary format): unknown exception caught", Py_TYPE(self)->tp_name, filename);
+    return 0;
+  }
+
+  Py_RETURN_NONE;
+
+}
+
+PyDoc_STRVAR(s_quantization_error_str, "quantization_error");
+PyDoc_STRVAR(s_quantization_error_doc,
+"o.quantization_error(input) -> (array, int)\n\
+\n\
+Measures the effect of :py:attr:`quantization` on a calibration\n\
+set. Every row of the 2D 64-bit float ``input`` array is scored\n\
+with the quantized support vectors and by LIBSVM. Returns the\n\
+largest absolute difference between the scores of each row, in a\n\
+1D ``float64`` array, and the number of rows whose predicted class\n\
+differs (always ``0`` for regression machines).\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_quantizationError
+(PyBobLearnLibsvmMachineObject* self, PyObject* args, PyObject* kwds) {
+
+  static const char* const_kwlist[] = {"input", 0};
+  static char** kwlist = const_cast<char**>(const_kwlist);
+
+  PyBlitzArrayObject* input = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", kwlist,
+        &PyBlitzArray_Converter, &input)) return 0;
+
+  //protects acquired resources through this scope
+  auto input_ = make_safe(input);
+
+  if (input->type_num != NPY_FLOAT64 || input->ndim != 2) {
+    PyErr_Format(PyExc_TypeError, "`%s' only supports 2D 64-bit float arrays for input array `input'", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  Py_ssize_t osize = input->shape[0];
+  PyBlitzArrayObject* errors = (PyBlitzArrayObject*)PyBlitzArray_SimpleNew(NPY_FLOAT64, 1, &osize);
+  if (!errors) return 0;
+  auto errors_ = make_safe(errors);
+
+  size_t changed = 0;
+  try {
+    auto bzin = PyBlitzArrayCxx_AsBlitz<double,2>(input);
+    auto bzerrors = PyBlitzArrayCxx_AsBlitz<double,1>(errors);
+    PyBobLearnLibsvmMachine_NoGIL nogil(self); ///< arrays are protected by this scope
+    changed = self->cxx->quantizationError(*bzin, *bzerrors);
+  }
+  catch (std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return 0;
+  }
+  catch (...) {
+    PyErr_Format(PyExc_RuntimeError, "%s cannot measure quantization errors: unknown exception caught", Py_TYPE(self)->tp_name);
+    return 0;
+  }
+
+  Py_INCREF(errors);
+  return Py_BuildValue("Nn",
+      PyBlitzArray_NUMPY_WRAP(reinterpret_cast<PyObject*>(errors)), changed);
+
+}
+
+PyDoc_STRVAR(s_allocations_str, "allocations");
+PyDoc_STRVAR(s_allocations_doc,
+"Machine.allocations() -> int\n\
+\n\
+Returns how many times predictions allocated memory, summed over\n\
+all machines and threads since the module was loaded. This counts\n\
+output arrays that were not pre-allocated and the working memory of\n\
+predictions, which each thread keeps for its next calls, including\n\
+the threads batch predictions run on when :py:attr:`n_threads` is\n\
+larger than 1. Once warm, predicting numpy arrays of 32 or 64-bit\n\
+floats into pre-allocated outputs with a :py:attr:`dense` or\n\
+:py:attr:`collapsed` machine does not allocate memory, so this\n\
+counter stops growing.\n\
+Evaluations by LIBSVM itself count as one allocation each.\n\
+");
+
+static PyObject* PyBobLearnLibsvmMachine_allocations(PyObject*, PyObject*) {
+  return Py_BuildValue("n", bob::learn::libsvm::Machine::allocations());
+}
+
 PyDoc_STRVAR(s_predict_class_str, "predict_class");
 
 static PyMethodDef PyBobLearnLibsvmMachine_methods[] = {
@@ -1033,6 +2006,24 @@ static PyMethodDef PyBobLearnLibsvmMachine_methods[] = {
     METH_O,
     s_save_doc
   },
+  {
+    s_save_binary_str,
+    (PyCFunction)PyBobLearnLibsvmMachine_saveBinary,
+    METH_O,
+    s_save_binary_doc
+  },
+  {
+    s_quantization_error_str,
+    (PyCFunction)PyBobLearnLibsvmMachine_quantizationError,
+    METH_VARARGS|METH_KEYWORDS,
+    s_quantization_error_doc
+  },
+  {
+    s_allocations_str,
+    (PyCFunction)PyBobLearnLibsvmMachine_allocations,
+    METH_NOARGS|METH_STATIC,
+    s_allocations_doc
+  },
   {0} /* Sentinel */
 };
 
@@ -1044,6 +2035,7 @@ static PyObject* PyBobLearnLibsvmMachine_new
     (PyBobLearnLibsvmMachineObject*)type->tp_alloc(type, 0);
 
   self->cxx = 0;
+  self->predictions = 0;
 
   return reinterpret_cast<PyObject*>(self);
 
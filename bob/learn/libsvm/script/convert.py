@@ -0,0 +1,37 @@
+#!/usr/bin/env python
+# vim: set fileencoding=utf-8 :
+# Fri 16 Oct 2026 21:41:03 CEST
+
+"""Converts LIBSVM or HDF5 machines into the binary format of
+:py:meth:`bob.learn.libsvm.Machine.save_binary`, which loads without parsing.
+"""
+
+import sys
+import argparse
+
+import bob.io.base
+
+from .. import Machine
+
+def load(path):
+  """Loads a machine from a LIBSVM model file or from an HDF5 file"""
+
+  try:
+    f = bob.io.base.HDF5File(path)
+  except RuntimeError:
+    return Machine(path) #not an HDF5 file: LIBSVM's text or binary format
+  return Machine(f)
+
+def main(argv=None):
+
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument('input', help='LIBSVM model file or HDF5 file, as written by Machine.save()')
+  parser.add_argument('output', help='binary model file to write')
+  args = parser.parse_args(argv)
+
+  machine = load(args.input)
+  machine.save_binary(args.output)
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -15,7 +15,13 @@ import pkg_resources
 import nose.tools
 import bob.io.base
 
-from . import File, Machine
+from . import File, Machine, Trainer
+
+def assert_same_scores(a, b):
+  """Scores of the same inputs, on one or several threads, one by one or by
+  batches, should be the same bit for bit"""
+
+  assert numpy.array_equal(a, b)
 
 def F(f):
   """Returns the test file on the "data" subdirectory"""
@@ -37,6 +43,21 @@ IRIS_DATA = F('iris.svmdata')
 IRIS_MACHINE = F('iris.svmmodel')
 IRIS_EXPECTED = F('iris.out') #expected probabilities
 
+def decimal_comma_locale():
+  """Switches LC_NUMERIC to a locale writing 0.5 as "0,5", if one is
+  installed, and returns the previous setting, or None otherwise"""
+
+  import locale
+  previous = locale.setlocale(locale.LC_NUMERIC)
+  for name in ('de_DE.UTF-8', 'fr_FR.UTF-8', 'de_DE', 'fr_FR', 'German'):
+    try:
+      locale.setlocale(locale.LC_NUMERIC, name)
+    except locale.Error:
+      continue
+    if locale.localeconv()['decimal_point'] == ',': return previous
+    locale.setlocale(locale.LC_NUMERIC, previous)
+  return None
+
 def load_expected(filename):
   """Loads libsvm's svm-predict output file with probabilities"""
 
@@ -132,6 +153,276 @@ def test_can_save_h5():
 def test_can_save_hdf5():
   run_for_extension('.hdf5')
 
+def test_hdf5_layout():
+
+  machine = Machine(HEART_MACHINE)
+  labels, data = File(HEART_DATA).read_all()
+  expected = machine.predict_class_and_probabilities(data)
+
+  # models are stored as typed datasets
+  tmp = tempname('.hdf5')
+  machine.save(bob.io.base.HDF5File(tmp, 'w'))
+  f = bob.io.base.HDF5File(tmp)
+  assert not f.has_key('svm_model')
+  nose.tools.eq_(f.read('sv_coef').shape, (1, 132))
+  nose.tools.eq_(f.read('support_vectors').shape, (132, 13))
+  nose.tools.eq_(list(f.read('nSV')), [64, 68])
+  del f
+
+  # inconsistent models are refused
+  def rewrite(**changes):
+    src = bob.io.base.HDF5File(tmp)
+    broken = tempname('.hdf5')
+    dst = bob.io.base.HDF5File(broken, 'w')
+    for key in src.keys(relative=True):
+      if key in changes: continue
+      dst.set(key, src.read(key))
+    for key, value in changes.items():
+      if value is not None: dst.set(key, value)
+    dst.set_attribute('version', src.get_attribute('version'))
+    del src, dst
+    try:
+      nose.tools.assert_raises(RuntimeError, Machine,
+          bob.io.base.HDF5File(broken))
+    finally:
+      os.unlink(broken)
+
+  rewrite(nSV=None)
+  rewrite(label=None)
+  rewrite(nSV=numpy.array([64, 67], 'int64'))
+  rewrite(nSV=numpy.array([-1, 133], 'int64'))
+  for indices in ([-2, 1], [2, 1], [1, 1]):
+    rewrite(support_vectors=None,
+        sv_indptr=numpy.array([0] + [2] * 132, 'int64'),
+        sv_indices=numpy.array(indices, 'int64'),
+        sv_values=numpy.ones((2,), 'float64'))
+  os.unlink(tmp)
+
+  # models with index 0 are stored in CSR format and read back
+  svmmodel = tempname('.svmmodel')
+  try:
+    write_zero_index_model(svmmodel)
+    machine = Machine(svmmodel)
+  finally:
+    os.unlink(svmmodel)
+  expected_zero = machine.predict_class_and_scores(data)
+  machine.save(bob.io.base.HDF5File(tmp, 'w'))
+  f = bob.io.base.HDF5File(tmp)
+  assert not f.has_key('support_vectors')
+  nose.tools.eq_(f.read('sv_indices')[0], 0)
+  del f
+  loaded = Machine(bob.io.base.HDF5File(tmp))
+  os.unlink(tmp)
+  assert not loaded.dense
+  pred_labels, pred_scores = loaded.predict_class_and_scores(data)
+  assert numpy.array_equal(pred_labels, expected_zero[0])
+  assert numpy.array_equal(pred_scores, expected_zero[1])
+
+  # files written by earlier versions hold the model as a text blob
+  f = bob.io.base.HDF5File(tmp, 'w')
+  f.set('svm_model', numpy.fromfile(HEART_MACHINE, 'uint8'))
+  f.set('input_subtract', numpy.zeros((13,)))
+  f.set('input_divide', numpy.ones((13,)))
+  f.set_attribute('version', numpy.uint64(300))
+  del f
+  loaded = Machine(bob.io.base.HDF5File(tmp))
+  os.unlink(tmp)
+  pred_labels, pred_probs = loaded.predict_class_and_probabilities(data)
+  assert numpy.array_equal(pred_labels, expected[0])
+  assert numpy.array_equal(pred_probs, expected[1])
+
+def test_parallel_load():
+
+  # a heart model with every support vector repeated, over a few MiB
+  with open(HEART_MACHINE) as f: lines = f.read().splitlines()
+  start = lines.index('SV') + 1
+  header = [k for k in lines[:start] if not k.startswith(('total_sv', 'nr_sv'))]
+  header.insert(-1, 'total_sv %d' % (200 * 132))
+  header.insert(-1, 'nr_sv %d %d' % (200 * 64, 200 * 68))
+  sv = lines[start:start+64] * 200 + lines[start+64:start+132] * 200
+  tmp = tempname('.svmmodel')
+  with open(tmp, 'w') as f: f.write('\n'.join(header + sv) + '\n')
+
+  labels, data = File(HEART_DATA).read_all()
+  threads = os.environ.get('BOB_LEARN_LIBSVM_THREADS')
+  results = []
+  try:
+    for k in ('1', '4'):
+      os.environ['BOB_LEARN_LIBSVM_THREADS'] = k
+      machine = Machine(tmp)
+      nose.tools.eq_(machine.n_support_vectors, [200 * 64, 200 * 68])
+      results.append(machine.predict_class_and_scores(data))
+  finally:
+    if threads is None: del os.environ['BOB_LEARN_LIBSVM_THREADS']
+    else: os.environ['BOB_LEARN_LIBSVM_THREADS'] = threads
+    os.unlink(tmp)
+
+  # the model does not depend on the number of threads
+  assert numpy.array_equal(results[0][0], results[1][0])
+  assert numpy.array_equal(results[0][1], results[1][1])
+
+def test_load_whatever_locale():
+
+  # models are read in the "C" locale, as libsvm writes them
+  import locale
+  labels, data = File(HEART_DATA).read_all()
+  expected = Machine(HEART_MACHINE).predict_class_and_scores(data)
+  previous = decimal_comma_locale()
+  if previous is None: return #no such locale installed
+  try:
+    machine = Machine(HEART_MACHINE)
+  finally:
+    locale.setlocale(locale.LC_NUMERIC, previous)
+  pred_labels, pred_scores = machine.predict_class_and_scores(data)
+  assert numpy.array_equal(pred_labels, expected[0])
+  assert numpy.array_equal(pred_scores, expected[1])
+
+def write_zero_index_model(filename):
+  """Writes the heart model, with a value at index 0 for its first support
+  vector, as svm-train accepts them"""
+
+  with open(HEART_MACHINE) as f: text = f.read()
+  start = text.index(' ', text.index('\nSV\n') + 4) + 1 #after its coefficient
+  with open(filename, 'w') as f: f.write(text[:start] + '0:0.5 ' + text[start:])
+
+def test_load_zero_index():
+
+  # such models are evaluated by libsvm, as the dense rows start at index 1
+  tmp = tempname('.svmmodel')
+  try:
+    write_zero_index_model(tmp)
+    machine = Machine(tmp)
+  finally:
+    os.unlink(tmp)
+  assert not machine.dense
+  nose.tools.assert_raises(RuntimeError, setattr, machine, 'dense', True)
+  labels, data = File(HEART_DATA).read_all()
+  pred_labels = machine.predict_class(data)
+  nose.tools.eq_(pred_labels.shape, (len(data),))
+
+def test_load_invalid_vectors():
+
+  # indices are not negative and values are separated by white space
+  with open(HEART_MACHINE) as f: text = f.read()
+  start = text.index('\nSV\n') + 4
+  tmp = tempname('.svmmodel')
+  try:
+    for line in ('1 -2:0.5\n', '1 1:0.5,2 2:1\n', '1x 1:0.5\n'):
+      with open(tmp, 'w') as f: f.write(text[:start] + line + text[start:])
+      nose.tools.assert_raises(RuntimeError, Machine, tmp)
+  finally:
+    os.unlink(tmp)
+
+def test_save_without_temporary_files():
+
+  # models are pickled into HDF5 files in memory, so TMPDIR is not used
+  tmp = tempname('.hdf5')
+  machine = Machine(IRIS_MACHINE)
+  labels, data = File(IRIS_DATA).read_all()
+  expected = machine.predict_class_and_scores(data)
+
+  tmpdir = os.environ.get('TMPDIR')
+  os.environ['TMPDIR'] = os.path.join(tmp, 'does', 'not', 'exist')
+  try:
+    machine.save(bob.io.base.HDF5File(tmp, 'w'))
+    loaded = Machine(bob.io.base.HDF5File(tmp))
+  finally:
+    if tmpdir is None: del os.environ['TMPDIR']
+    else: os.environ['TMPDIR'] = tmpdir
+  os.unlink(tmp)
+
+  pred_labels, pred_scores = loaded.predict_class_and_scores(data)
+  assert numpy.array_equal(pred_labels, expected[0])
+  assert numpy.array_equal(pred_scores, expected[1])
+
+def test_binary_format():
+
+  from .script import convert
+
+  labels, data = File(IRIS_DATA).read_all()
+  machine = Machine(IRIS_MACHINE)
+  machine.input_subtract = numpy.linspace(0, 1, 4)
+  machine.input_divide = numpy.linspace(1, 2, 4)
+  expected = machine.predict_class_and_probabilities(data)
+
+  # models converted from HDF5 keep their scaling
+  h5 = tempname('.hdf5')
+  machine.save(bob.io.base.HDF5File(h5, 'w'))
+  tmp = tempname('.bin')
+  nose.tools.eq_(convert.main([h5, tmp]), 0)
+  os.unlink(h5)
+
+  # classifiers with missing or inconsistent numbers of support vectors per
+  # class are refused: the NR_SV section is described at byte 104
+  import struct
+  with open(tmp, 'rb') as f: original = f.read()
+  offset, size = struct.unpack_from('=QQ', original, 104)
+  n_sv = numpy.frombuffer(original, 'int32', size // 4, offset)
+  for section, values in (((offset, 0), n_sv), ((offset, size), n_sv - 1),
+      ((offset, size), n_sv * [-1, 1, 2])):
+    broken = bytearray(original)
+    struct.pack_into('=QQ', broken, 104, *section)
+    broken[offset:offset+size] = values.astype('int32').tobytes()
+    with open(tmp, 'wb') as f: f.write(broken)
+    nose.tools.assert_raises(RuntimeError, Machine, tmp)
+
+  # so are strides that cannot fit in the file: the stride is at byte 72
+  broken = bytearray(original)
+  struct.pack_into('=Q', broken, 72, 2**62)
+  with open(tmp, 'wb') as f: f.write(broken)
+  nose.tools.assert_raises(RuntimeError, Machine, tmp)
+  with open(tmp, 'wb') as f: f.write(original)
+
+  loaded = Machine(tmp)
+  os.unlink(tmp)
+  nose.tools.eq_(loaded.shape, machine.shape)
+  nose.tools.eq_(loaded.n_support_vectors, machine.n_support_vectors)
+  assert loaded.dense
+  assert numpy.array_equal(loaded.input_subtract, machine.input_subtract)
+  assert numpy.array_equal(loaded.input_divide, machine.input_divide)
+  pred_labels, pred_probs = loaded.predict_class_and_probabilities(data)
+  assert numpy.array_equal(pred_labels, expected[0])
+  assert numpy.array_equal(pred_probs, expected[1])
+
+  # LINEAR models are collapsed on load, as when read from text
+  trainer = Trainer()
+  trainer.kernel_type = 'LINEAR'
+  machine = trainer.train([data[labels == k] for k in (1, 2, 3)])
+  expected = machine.predict_class_and_scores(data)
+  machine.save_binary(tmp)
+  loaded = Machine(tmp)
+  os.unlink(tmp)
+  assert loaded.collapsed
+  pred_labels, pred_scores = loaded.predict_class_and_scores(data)
+  assert numpy.array_equal(pred_labels, expected[0])
+  assert numpy.array_equal(pred_scores, expected[1])
+
+  # models with index 0 are stored as nodes, whose indices are checked: the
+  # SV_NODES section is described at byte 232
+  text = tempname('.svmmodel')
+  try:
+    write_zero_index_model(text)
+    machine = Machine(text)
+  finally:
+    os.unlink(text)
+  labels, data = File(HEART_DATA).read_all()
+  expected = machine.predict_class_and_scores(data)
+  machine.save_binary(tmp)
+  with open(tmp, 'rb') as f: original = f.read()
+  offset, size = struct.unpack_from('=QQ', original, 232)
+  for index in (-2, 1000):
+    broken = bytearray(original)
+    struct.pack_into('=i', broken, offset, index)
+    with open(tmp, 'wb') as f: f.write(broken)
+    nose.tools.assert_raises(RuntimeError, Machine, tmp)
+  with open(tmp, 'wb') as f: f.write(original)
+  loaded = Machine(tmp)
+  os.unlink(tmp)
+  assert not loaded.dense
+  pred_labels, pred_scores = loaded.predict_class_and_scores(data)
+  assert numpy.array_equal(pred_labels, expected[0])
+  assert numpy.array_equal(pred_scores, expected[1])
+
 def test_data_loading():
 
   #tests if I can load data in libsvm format using SVMFile
@@ -191,6 +482,126 @@ def test_data_loading():
     assert numpy.array_equal(e, data[k])
 
 
+def test_data_single_sweep():
+
+  #reading all data from a file which was not inspected yet
+  ref_labels, ref_data = File(HEART_DATA).read_all(
+      numpy.ndarray((270,), 'int64'), numpy.ndarray((270, 13), 'float64'))
+
+  data = File(HEART_DATA)
+  labels, values = data.read_all()
+  nose.tools.eq_(data.shape, (13,))
+  nose.tools.eq_(data.samples, 270)
+  assert numpy.array_equal(labels, ref_labels)
+  assert numpy.array_equal(values, ref_data)
+
+  #blank lines, carriage returns and a missing final new line are tolerated
+  tmp = tempname('.svmdata')
+  with open(tmp, 'wt') as f:
+    f.write('\n+1 3:1.5 1:-2e-3\r\n  \n-1\n2\t2:4 5:1e3')
+
+  try:
+    labels, values = File(tmp).read_all()
+    assert numpy.array_equal(labels, [1, -1, 2])
+    assert numpy.array_equal(values, [[-2e-3, 0, 1.5, 0, 0], [0, 0, 0, 0, 0],
+      [0, 4, 0, 0, 1e3]])
+
+    #malformed pairs are refused
+    with open(tmp, 'wt') as f: f.write('1 1:1\n1 1: 2\n')
+    nose.tools.assert_raises(RuntimeError, File(tmp).read_all)
+
+    #including an index without value at the very end of the file
+    with open(tmp, 'wt') as f: f.write('1 1:1\n1 12')
+    data = File(tmp)
+    nose.tools.eq_(data.shape, (12,))
+    nose.tools.assert_raises(RuntimeError, data.read_all)
+
+  finally:
+    os.unlink(tmp)
+
+
+def test_data_random_access():
+
+  labels, values = File(HEART_DATA).read_all()
+
+  #samples are read in any order, without disturbing sequential reads
+  data = File(HEART_DATA)
+  first = data.read()
+  order = numpy.random.RandomState(7).permutation(270)
+  for k in order:
+    label, sample = data.read_sample(int(k))
+    nose.tools.eq_(label, labels[k])
+    assert numpy.array_equal(sample, values[k])
+  nose.tools.eq_(first[0], labels[0])
+  nose.tools.eq_(data.read()[0], labels[1])
+
+  #ranges of samples, into pre-allocated arrays or not
+  l, v = data.read_samples(100, 132)
+  assert numpy.array_equal(l, labels[100:132])
+  assert numpy.array_equal(v, values[100:132])
+  l = numpy.ndarray((5,), 'int64')
+  v = numpy.ndarray((5, 13), 'float64')
+  data.read_samples(265, 270, l, v)
+  assert numpy.array_equal(l, labels[265:])
+  assert numpy.array_equal(v, values[265:])
+  nose.tools.eq_(data.read_samples(270, 270)[1].shape, (0, 13))
+
+  nose.tools.assert_raises(RuntimeError, data.read_sample, 270)
+  nose.tools.assert_raises(RuntimeError, data.read_sample, -1)
+  nose.tools.assert_raises(RuntimeError, data.read_samples, 260, 271)
+
+def test_data_whatever_locale():
+
+  # values are read in the "C" locale, as the original streams did
+  import locale
+  labels, values = File(HEART_DATA).read_all()
+  previous = decimal_comma_locale()
+  if previous is None: return #no such locale installed
+  try:
+    l, v = File(HEART_DATA).read_all()
+    data = File(HEART_DATA)
+    first = data.read()
+  finally:
+    locale.setlocale(locale.LC_NUMERIC, previous)
+  assert numpy.array_equal(l, labels)
+  assert numpy.array_equal(v, values)
+  nose.tools.eq_(first[0], labels[0])
+  assert numpy.array_equal(first[1], values[0])
+
+def test_data_parallel_read():
+
+  # the heart data, repeated over a few MiB
+  with open(HEART_DATA) as f: text = f.read()
+  tmp = tempname('.svmdata')
+  with open(tmp, 'wt') as f: f.write(text * 200)
+
+  labels, values = File(HEART_DATA).read_all()
+  labels = numpy.tile(labels, 200)
+  values = numpy.tile(values, (200, 1))
+
+  try:
+    for threads in (1, 4):
+      # into arrays allocated once the file is scanned
+      data = File(tmp)
+      data.n_threads = threads
+      nose.tools.eq_(data.n_threads, threads)
+      l, v = data.read_all()
+      assert numpy.array_equal(l, labels)
+      assert numpy.array_equal(v, values)
+
+      # into pre-allocated arrays, once the file was inspected
+      data = File(tmp)
+      data.n_threads = threads
+      l = numpy.ndarray((data.samples,), 'int64')
+      v = numpy.ndarray((data.samples,) + data.shape, 'float64')
+      data.read_all(l, v)
+      assert numpy.array_equal(l, labels)
+      assert numpy.array_equal(v, values)
+
+  finally:
+    os.unlink(tmp)
+
+
 @nose.tools.raises(RuntimeError)
 def test_raises():
 
@@ -215,7 +626,7 @@ def test_correctness_heart():
   #tries the variant with multiple inputs
   pred_labels2, pred_scores2 = machine.predict_class_and_scores(data)
   assert numpy.array_equal(expected_heart_predictions,  pred_labels2)
-  assert numpy.array_equal(tuple([k[1] for k in pred_lab_values]), pred_scores2)
+  assert_same_scores(tuple([k[1] for k in pred_lab_values]), pred_scores2)
 
   #tries to get the probabilities - note: for some reason, when getting
   #probabilities, the labels change, but notice the note bellow:
@@ -250,8 +661,7 @@ def test_correctness_iris():
   #tries the variant with multiple inputs
   pred_labels2, pred_scores2 = machine.predict_class_and_scores(data)
   assert numpy.array_equal(expected_iris_predictions,  pred_labels2)
-  assert numpy.all(abs(numpy.vstack([k[1] for k in
-    pred_lab_values]) - numpy.vstack(pred_scores2)) < 1e-20 )
+  assert_same_scores(tuple([k[1] for k in pred_lab_values]), pred_scores2)
 
   #tries to get the probabilities - note: for some reason, when getting
   #probabilities, the labels change, but notice the note bellow:
@@ -274,3 +684,429 @@ def test_correctness_inputsize_exceeds():
   data = numpy.hstack([data, numpy.ones((data.shape[0], 2), dtype=float)])
 
   pred_label = machine.predict_class(data)
+
+def test_concurrent_prediction():
+
+  # a single machine should serve several threads at once
+  import threading
+  machine = Machine(IRIS_MACHINE)
+  labels, data = File(IRIS_DATA).read_all()
+  expected_labels, expected_scores = machine.predict_class_and_scores(data)
+
+  results = [None] * 8
+  def run(k):
+    results[k] = [machine.predict_class_and_scores(data) for i in range(20)]
+
+  threads = [threading.Thread(target=run, args=(k,)) for k in range(len(results))]
+  for t in threads: t.start()
+  for t in threads: t.join()
+
+  for result in results:
+    for pred_labels, pred_scores in result:
+      assert numpy.array_equal(pred_labels, expected_labels)
+      assert numpy.array_equal(pred_scores, expected_scores)
+
+def test_setters_during_prediction():
+
+  # the machine cannot be changed under predictions running on other threads
+  import threading
+  machine = Machine(HEART_MACHINE)
+  labels, data = File(HEART_DATA).read_all()
+  data = numpy.vstack([data] * 20)
+  expected_labels, expected_scores = machine.predict_class_and_scores(data)
+
+  results = []
+  def run():
+    for i in range(10):
+      results.append(machine.predict_class_and_scores(data))
+
+  thread = threading.Thread(target=run)
+  thread.start()
+  while thread.is_alive():
+    try:
+      machine.dense = not machine.dense
+      machine.input_subtract = numpy.zeros((13,), 'float64')
+    except RuntimeError:
+      pass
+  thread.join()
+
+  for pred_labels, pred_scores in results:
+    assert numpy.array_equal(pred_labels, expected_labels)
+    assert numpy.all(abs(pred_scores - expected_scores) < 1e-10)
+
+  # once predictions are done, the machine may be changed again
+  machine.dense = True
+  nose.tools.eq_(machine.dense, True)
+
+def test_multithreaded_batch():
+
+  # splitting the batch over threads should not change a single bit
+  machine = Machine(HEART_MACHINE)
+  labels, data = File(HEART_DATA).read_all()
+  data = numpy.vstack([data] * 4)
+  machine.n_threads = 1
+  serial_labels = machine.predict_class(data)
+  serial = machine.predict_class_and_probabilities(data)
+
+  machine.n_threads = 4
+  nose.tools.eq_(machine.n_threads, 4)
+  assert numpy.array_equal(machine.predict_class(data), serial_labels)
+  parallel = machine.predict_class_and_probabilities(data)
+  assert numpy.array_equal(serial[0], parallel[0])
+  assert_same_scores(serial[1], parallel[1])
+
+def test_multithreaded_after_fork():
+
+  # a forked child has none of the threads of its parent, it starts its own
+  if not hasattr(os, 'fork'): return
+  import signal
+  machine = Machine(HEART_MACHINE)
+  labels, data = File(HEART_DATA).read_all()
+  data = numpy.vstack([data] * 4)
+  machine.n_threads = 4
+  expected = machine.predict_class(data)
+
+  pid = os.fork()
+  if pid == 0:
+    status = 1
+    try:
+      signal.alarm(60) #kills the child if it hangs
+      if numpy.array_equal(machine.predict_class(data), expected): status = 0
+    finally:
+      os._exit(status)
+
+  pid, status = os.waitpid(pid, 0)
+  nose.tools.eq_(status, 0)
+
+def test_dense_matches_libsvm():
+
+  # the dense evaluator must reproduce libsvm's own results, up to rounding
+  # differences due to the vectorized kernels
+  for model, datafile in ((HEART_MACHINE, HEART_DATA), (IRIS_MACHINE, IRIS_DATA)):
+    machine = Machine(model)
+    labels, data = File(datafile).read_all()
+    nose.tools.eq_(machine.dense, True)
+    dense_labels, dense_scores = machine.predict_class_and_scores(data)
+    dense_probs = machine.predict_class_and_probabilities(data)
+
+    machine.dense = False
+    nose.tools.eq_(machine.dense, False)
+    sparse_labels, sparse_scores = machine.predict_class_and_scores(data)
+    sparse_probs = machine.predict_class_and_probabilities(data)
+
+    assert numpy.array_equal(dense_labels, sparse_labels)
+    assert numpy.all(abs(dense_scores - sparse_scores) < 1e-10)
+    assert numpy.array_equal(dense_probs[0], sparse_probs[0])
+    # older libsvm releases iterate on binary problems, instead of solving
+    # them exactly, so probabilities may differ slightly
+    assert numpy.all(abs(dense_probs[1] - sparse_probs[1]) < 1e-2)
+
+def test_collapsed_linear():
+
+  labels, data = File(IRIS_DATA).read_all()
+  trainer = Trainer()
+  trainer.kernel_type = 'LINEAR'
+  machine = trainer.train([data[labels == k] for k in (1, 2, 3)])
+
+  nose.tools.eq_(machine.collapsed, True)
+  nose.tools.eq_(machine.dense, False)
+  nose.tools.eq_(machine.weights.shape, (3, 4))
+  collapsed_labels, collapsed_scores = machine.predict_class_and_scores(data)
+
+  # scores are linear in the input, with the reported weights
+  diff = collapsed_scores[1:] - collapsed_scores[:-1]
+  expected = numpy.dot(data[1:] - data[:-1], machine.weights.T)
+  assert numpy.all(abs(diff - expected) < 1e-8)
+
+  machine.collapsed = False
+  nose.tools.eq_(machine.collapsed, False)
+  libsvm_labels, libsvm_scores = machine.predict_class_and_scores(data)
+  assert numpy.array_equal(collapsed_labels, libsvm_labels)
+  assert numpy.all(abs(collapsed_scores - libsvm_scores) < 1e-8)
+
+  # other kernels cannot be collapsed
+  machine = Machine(IRIS_MACHINE)
+  nose.tools.eq_(machine.collapsed, False)
+  nose.tools.eq_(machine.weights, None)
+  def collapse(): machine.collapsed = True
+  nose.tools.assert_raises(RuntimeError, collapse)
+
+def test_folded_scaling():
+
+  labels, data = File(IRIS_DATA).read_all()
+  subtract = numpy.array([0.1, -0.2, 0.05, 0.], 'float64')
+  divide = numpy.array([0.5, 2., 1.25, 0.75], 'float64')
+  scaled = (data - subtract) / divide
+
+  trainer = Trainer()
+  trainer.kernel_type = 'LINEAR'
+  for machine in (Machine(IRIS_MACHINE),
+      trainer.train([data[labels == k] for k in (1, 2, 3)])):
+
+    expected_labels, expected_scores = machine.predict_class_and_scores(scaled)
+    machine.input_subtract = subtract
+    machine.input_divide = divide
+    scaled_labels, scaled_scores = machine.predict_class_and_scores(data)
+    assert numpy.array_equal(scaled_labels, expected_labels)
+    assert numpy.all(abs(scaled_scores - expected_scores) < 1e-8)
+
+    # scaling survives a round-trip through HDF5
+    tmp = tempname('.hdf5')
+    machine.save(bob.io.base.HDF5File(tmp, 'w'))
+    loaded = Machine(bob.io.base.HDF5File(tmp))
+    os.unlink(tmp)
+    loaded_labels, loaded_scores = loaded.predict_class_and_scores(data)
+    assert numpy.array_equal(loaded_labels, expected_labels)
+    assert numpy.all(abs(loaded_scores - expected_scores) < 1e-8)
+
+def test_single_precision():
+
+  # float evaluation must not change labels, and only round scores
+
+  for model, datafile in ((HEART_MACHINE, HEART_DATA), (IRIS_MACHINE, IRIS_DATA)):
+    machine = Machine(model)
+    labels, data = File(datafile).read_all()
+    assert not machine.single_precision
+    double_scores = machine.predict_class_and_scores(data)
+    double_probs = machine.predict_class_and_probabilities(data)
+
+    machine.single_precision = True
+    assert machine.single_precision
+    single_scores = machine.predict_class_and_scores(data)
+    single_probs = machine.predict_class_and_probabilities(data)
+    assert numpy.array_equal(single_scores[0], double_scores[0])
+    assert numpy.all(abs(single_scores[1] - double_scores[1]) < 1e-4)
+    assert numpy.array_equal(single_probs[0], double_probs[0])
+    assert numpy.all(abs(single_probs[1] - double_probs[1]) < 1e-4)
+
+    # not available for models evaluated by libsvm
+    machine.dense = False
+    assert not machine.single_precision
+    nose.tools.assert_raises(RuntimeError, setattr, machine,
+        'single_precision', True)
+
+def test_float_and_strided_input():
+
+  # float32 and non-contiguous inputs are converted while being read, with
+  # the same results as float64 copies of them
+  machine = Machine(IRIS_MACHINE)
+  labels, data = File(IRIS_DATA).read_all()
+  single = data.astype('float32')
+  double = single.astype('float64')
+  expected_labels, expected_scores = machine.predict_class_and_scores(double)
+  expected_probs = machine.predict_class_and_probabilities(double)[1]
+
+  wide = numpy.zeros((data.shape[0], 2 * data.shape[1]), 'float32')
+  wide[:, ::2] = single
+  for input in (single, wide[:, ::2], numpy.asfortranarray(single),
+      numpy.asfortranarray(double)):
+    assert numpy.array_equal(machine(input), expected_labels)
+    pred_labels, pred_scores = machine.predict_class_and_scores(input)
+    assert numpy.array_equal(pred_labels, expected_labels)
+    assert_same_scores(pred_scores, expected_scores)
+    pred_probs = machine.predict_class_and_probabilities(input)[1]
+    assert_same_scores(pred_probs, expected_probs)
+
+  for k in range(0, len(data), 10):
+    row = wide[k, ::2]
+    nose.tools.eq_(machine(row)[0], expected_labels[k])
+    pred_scores = machine.predict_class_and_scores(row)[1]
+    assert numpy.all(abs(pred_scores - expected_scores[k]) < 1e-12)
+
+  nose.tools.assert_raises(TypeError, machine, data.astype('int32'))
+
+def test_quantization():
+
+  for model, datafile in ((HEART_MACHINE, HEART_DATA), (IRIS_MACHINE, IRIS_DATA)):
+    machine = Machine(model)
+    labels, data = File(datafile).read_all()
+    nose.tools.eq_(machine.quantization, 0)
+    expected_labels, expected_scores = machine.predict_class_and_scores(data)
+    nose.tools.assert_raises(RuntimeError, machine.quantization_error, data)
+
+    for bits, tolerance in ((8, 5e-2), (16, 2e-4)):
+      machine.quantization = bits
+      nose.tools.eq_(machine.quantization, bits)
+      assert machine.dense
+      pred_labels, pred_scores = machine.predict_class_and_scores(data)
+      assert numpy.array_equal(pred_labels, expected_labels)
+      errors = abs(pred_scores - expected_scores).reshape(len(data), -1)
+      assert numpy.all(errors < tolerance)
+
+      # the report matches the differences with libsvm
+      report, changed = machine.quantization_error(data)
+      nose.tools.eq_(changed, 0)
+      assert numpy.all(abs(report - errors.max(axis=1)) < 1e-8)
+
+    machine.quantization = 0
+    pred_labels, pred_scores = machine.predict_class_and_scores(data)
+    assert numpy.array_equal(pred_scores, expected_scores)
+    nose.tools.assert_raises(RuntimeError, setattr, machine, 'quantization', 4)
+    machine.dense = False
+    nose.tools.assert_raises(RuntimeError, setattr, machine, 'quantization', 8)
+
+def test_compact():
+
+  for model, datafile in ((HEART_MACHINE, HEART_DATA), (IRIS_MACHINE, IRIS_DATA)):
+    machine = Machine(model)
+    labels, data = File(datafile).read_all()
+    assert machine.dense
+    assert machine.compact
+    expected = machine.predict_class_and_probabilities(data)
+
+    # nodes are rebuilt to save the machine
+    tmp = tempname('.hdf5')
+    machine.save(bob.io.base.HDF5File(tmp, 'w'))
+    loaded = Machine(bob.io.base.HDF5File(tmp))
+    os.unlink(tmp)
+    assert loaded.compact
+    result = loaded.predict_class_and_probabilities(data)
+    assert numpy.array_equal(result[0], expected[0])
+    assert numpy.allclose(result[1], expected[1], rtol=0, atol=1e-12)
+
+    # and for libsvm's evaluator
+    machine.dense = False
+    assert not machine.compact
+    nose.tools.assert_raises(RuntimeError, setattr, machine, 'compact', True)
+    result = machine.predict_class_and_probabilities(data)
+    assert numpy.array_equal(result[0], expected[0])
+    assert numpy.allclose(result[1], expected[1], rtol=0, atol=1e-8)
+
+    # quantization keeps the exact support vectors, unless asked otherwise
+    machine.dense = True
+    machine.compact = True
+    machine.quantization = 8
+    assert not machine.compact
+    machine.quantization_error(data)
+    machine.compact = True
+    nose.tools.assert_raises(RuntimeError, machine.quantization_error, data)
+
+def test_dense_large_features():
+
+  # RBF distances between inputs and support vectors far from the origin
+  # must not lose precision: features are moved by 1e4, which leaves
+  # distances, and thus the trained machine, unchanged
+  labels, data = File(HEART_DATA).read_all()
+  data = data + 1e4
+  machine = Trainer().train((data[labels > 0], data[labels < 0]))
+  assert machine.dense
+  dense_labels, dense_scores = machine.predict_class_and_scores(data)
+
+  machine.dense = False
+  sparse_labels, sparse_scores = machine.predict_class_and_scores(data)
+  assert numpy.array_equal(dense_labels, sparse_labels)
+  assert numpy.all(abs(dense_scores - sparse_scores) < 1e-10)
+
+def test_early_voting():
+
+  # 8 overlapping classes, so that votes are not always unanimous
+  numpy.random.seed(10)
+  centers = numpy.random.uniform(-1, 1, (8, 5))
+  data = [c + numpy.random.uniform(-1, 1, (30, 5)) for c in centers]
+  test = numpy.vstack(data) + numpy.random.uniform(-0.5, 0.5, (240, 5))
+
+  for kernel in ('RBF', 'LINEAR'):
+    trainer = Trainer()
+    trainer.kernel_type = kernel
+    machine = trainer.train(data)
+    nose.tools.eq_(machine.early_voting, True)
+    assert machine.dense or machine.collapsed
+
+    labels, scores = machine.predict_class_and_scores(test)
+    early = machine.predict_class(test)
+    assert numpy.array_equal(early, labels)
+    for row, label in zip(test, labels):
+      nose.tools.eq_(machine.predict_class(row), label)
+
+    machine.early_voting = False
+    assert numpy.array_equal(machine.predict_class(test), labels)
+
+class CSR(object):
+  """A minimal stand-in for scipy.sparse.csr_matrix"""
+
+  format = 'csr'
+
+  def __init__(self, dense, index_dtype='int32'):
+    rows, self.indices = numpy.nonzero(dense)
+    self.indices = self.indices.astype(index_dtype)
+    self.data = dense[rows, self.indices]
+    self.indptr = numpy.searchsorted(rows, numpy.arange(len(dense) + 1))
+
+def test_sparse_input():
+
+  for model, datafile in ((HEART_MACHINE, HEART_DATA), (IRIS_MACHINE, IRIS_DATA)):
+    machine = Machine(model)
+    labels, data = File(datafile).read_all()
+    data[::3, 1] = 0. #a few more zeros
+    sparse = CSR(data)
+
+    for dense in (True, False):
+      machine.dense = dense
+      expected = machine.predict_class_and_scores(data)
+      assert numpy.array_equal(machine(sparse), expected[0])
+      assert numpy.array_equal(machine.predict_class(input=sparse), expected[0])
+      pred_labels, pred_scores = machine.predict_class_and_scores(sparse)
+      assert numpy.array_equal(pred_labels, expected[0])
+      assert numpy.allclose(pred_scores, expected[1], rtol=0, atol=1e-12)
+      expected = machine.predict_class_and_probabilities(data)
+      pred_labels, pred_probs = machine.predict_class_and_probabilities(sparse)
+      assert numpy.array_equal(pred_labels, expected[0])
+      assert numpy.allclose(pred_probs, expected[1], rtol=0, atol=1e-12)
+
+    # pre-allocated outputs and extra columns
+    wide = CSR(numpy.hstack((data, numpy.ones((len(data), 2)))), 'int64')
+    cls = numpy.ndarray((len(data),), 'int64')
+    machine(wide, cls)
+    assert numpy.array_equal(cls, expected[0])
+
+    # column indices must be sorted
+    sparse.indices[:2] = sparse.indices[1::-1]
+    nose.tools.assert_raises(RuntimeError, machine, sparse)
+    sparse.format = 'csc'
+    nose.tools.assert_raises(TypeError, machine, sparse)
+
+def test_allocations():
+
+  machine = Machine(HEART_MACHINE)
+  labels, data = File(HEART_DATA).read_all()
+  one = numpy.ndarray((1,), 'int64')
+  prob = numpy.ndarray((2,), 'float64')
+  cls = numpy.ndarray((len(data),), 'int64')
+  scores = numpy.ndarray((len(data), 1), 'float64')
+
+  def predict():
+    for row in data[:20]:
+      machine(row, one)
+      machine.predict_class_and_probabilities(row, one, prob)
+    machine.predict_class_and_scores(data, cls, scores)
+    machine.predict_class_and_scores(data.astype('float32'), cls, scores)
+
+  # working memory is kept once the first calls have been served
+  predict()
+  start = Machine.allocations()
+  predict()
+  nose.tools.eq_(Machine.allocations(), start)
+  nose.tools.eq_(one[0], expected_heart_predictions[19])
+  assert numpy.array_equal(cls, expected_heart_predictions)
+
+  # so do the threads running batch predictions
+  machine.n_threads = 2
+  predict()
+  start = Machine.allocations()
+  predict()
+  nose.tools.eq_(Machine.allocations(), start)
+  assert numpy.array_equal(cls, expected_heart_predictions)
+  machine.n_threads = 1
+
+  # outputs that were not pre-allocated are counted
+  machine(data[0])
+  nose.tools.eq_(Machine.allocations(), start + 1)
+  machine.predict_class_and_scores(data)
+  nose.tools.eq_(Machine.allocations(), start + 3)
+
+  # as are evaluations by libsvm
+  machine.dense = False
+  machine(data[0], one)
+  start = Machine.allocations()
+  machine(data[0], one)
+  nose.tools.eq_(Machine.allocations(), start + 1)
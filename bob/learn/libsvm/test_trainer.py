@@ -125,6 +125,9 @@ def test_training():
   _check_abs_diff(machine.input_subtract, previous.input_subtract, 1e-8)
   _check_abs_diff(machine.input_divide, previous.input_divide, 1e-8)
 
+  # trained machines own their model, so they may release its nodes
+  assert machine.compact
+
   curr_label = machine.predict_class(data)
   prev_label = previous.predict_class(data)
   assert numpy.array_equal(curr_label, prev_label)
@@ -17,7 +17,7 @@ build_requires = load_requirements()
 version = open("version.txt").read().rstrip()
 
 packages = ['boost']
-boost_modules = ['system', 'filesystem']
+boost_modules = ['system', 'filesystem', 'thread']
 
 # process libsvm requirement
 import os
@@ -155,7 +155,12 @@ setup(
         [
           "bob/learn/libsvm/cpp/file.cpp",
           "bob/learn/libsvm/cpp/machine.cpp",
+          "bob/learn/libsvm/cpp/model.cpp",
+          "bob/learn/libsvm/cpp/binary.cpp",
           "bob/learn/libsvm/cpp/trainer.cpp",
+          "bob/learn/libsvm/cpp/parallel.cpp",
+          "bob/learn/libsvm/cpp/number.cpp",
+          "bob/learn/libsvm/cpp/kernel.cpp",
         ],
         bob_packages = bob_packages,
         version = version,
@@ -192,6 +197,7 @@ setup(
 
     entry_points={
       'console_scripts': [
+        'bob_svm_convert.py = bob.learn.libsvm.script.convert:main',
       ],
     },
 